@@ -1,8 +1,17 @@
 #pragma once
 
+#include "ARMS/arc.h"
 #include "ARMS/chassis.h"
+#include "ARMS/ekf.h"
+#include "ARMS/field.h"
 #include "ARMS/flags.h"
+#include "ARMS/mcl.h"
+#include "ARMS/mechanism.h"
+#include "ARMS/memory.h"
 #include "ARMS/odom.h"
 #include "ARMS/pid.h"
 #include "ARMS/point.h"
+#include "ARMS/power.h"
 #include "ARMS/selector.h"
+#include "ARMS/tracker.h"
+#include "ARMS/voltage.h"
@@ -0,0 +1,45 @@
+#ifndef _ARMS_ARC_H_
+#define _ARMS_ARC_H_
+
+#include <array>
+
+namespace arms::arc {
+
+/**
+ * Odometry integration over constant curvature arcs. Distances are in inches
+ * and angles in radians, counterclockwise positive.
+ */
+
+/**
+ * Return 2 * sin(x / 2) / x, the ratio of chord length to arc length for an
+ * arc spanning x radians
+ */
+double chordRatio(double x);
+
+/**
+ * Return the displacement {x, y} along the chord of an arc, in the robot
+ * frame at the start of the arc, given the distance travelled by the right
+ * and middle tracking wheels, the change in heading, the distance of the
+ * right wheel to the right of the tracking center and the distance of the
+ * middle wheel behind it
+ */
+std::array<double, 2> chord(double delta_right, double delta_middle,
+                            double delta_angle, double right_offset,
+                            double middle_distance);
+
+/**
+ * Move a pose {x, y, theta} by a chord displacement and change in heading
+ */
+void apply(std::array<double, 3>& pose, double local_x, double local_y,
+           double delta_angle);
+
+/**
+ * Return the fraction of a step covered by sub-step i of n. The rate ramps
+ * linearly from the previous step's rate to this step's, which models
+ * acceleration within the step when moving quickly.
+ */
+double substepWeight(int i, int n, double delta, double prev_delta);
+
+} // namespace arms::arc
+
+#endif
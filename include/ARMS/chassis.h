@@ -8,9 +8,118 @@
 
 namespace arms::chassis {
 
+// number of past movements whose status can be queried through a handle
+#define MOVE_HISTORY 16
+
+// number of actions that can be attached to movements at once
+#define MAX_TRIGGERS 8
+
+typedef enum MoveStatus {
+	MOVE_DONE,      // the movement reached its target
+	MOVE_RUNNING,   // the movement is in progress
+	MOVE_CANCELLED, // the movement was stopped through its handle
+	MOVE_PREEMPTED, // the movement was replaced by another movement
+	MOVE_ABORTED    // the movement was stopped by an odometry event
+} MoveStatus_e_t;
+
+/**
+ * A lightweight handle to a movement returned by move() and turn(). Starting
+ * a new movement preempts the running one at the next chassis tick.
+ */
+class MoveHandle {
+public:
+	explicit MoveHandle(uint32_t id = 0) : id(id) {
+	}
+
+	/**
+	 * Block until the movement is no longer running
+	 */
+	void wait();
+
+	/**
+	 * Block for up to ms milliseconds, returning true if the movement is no
+	 * longer running
+	 */
+	bool wait_for(uint32_t ms);
+
+	/**
+	 * Stop the movement if it is still running and brake the chassis
+	 */
+	void cancel();
+
+	/**
+	 * Return the fraction of the movement completed, from 0 to 1
+	 */
+	double progress();
+
+	/**
+	 * Return the status of the movement
+	 */
+	MoveStatus_e_t status();
+
+	/**
+	 * Attach actions that the chassis task runs once during the movement,
+	 * when it is a fraction complete, within an error of the target (inches,
+	 * or degrees for turns), or a time after it started. Progress and error
+	 * actions still run when the movement completes, but time actions whose
+	 * time has not come are dropped. Actions run inside the chassis task and
+	 * must return quickly. They may start new movements, which always run as
+	 * ASYNC there, but must not wait on a handle. Use with ASYNC movements:
+	 *
+	 *     move({24, 24}, ASYNC).at_progress(.6, intake).within(12, lift).wait();
+	 */
+	MoveHandle& at_progress(double fraction, void (*action)());
+	MoveHandle& within(double error, void (*action)());
+	MoveHandle& after(uint32_t ms, void (*action)());
+
+	/**
+	 * Stop the movement if any of the odometry events in the mask (see
+	 * odom::OdomEvent) are detected while it runs, ending it as MOVE_ABORTED:
+	 *
+	 *     move({24, 0}, ASYNC).abort_on(odom::EVENT_COLLISION).wait();
+	 */
+	MoveHandle& abort_on(int events);
+
+	// unique identifier of the movement
+	uint32_t id;
+};
+
 extern double maxSpeed;
+extern double maxRPM;       // free speed of the drive motors
+extern double max_velocity; // robot speed at full power (in/s)
 extern std::shared_ptr<pros::Motor_Group> leftMotors;
 extern std::shared_ptr<pros::Motor_Group> rightMotors;
+extern std::shared_ptr<pros::Motor_Group> leftBackMotors;
+extern std::shared_ptr<pros::Motor_Group> rightBackMotors;
+extern bool isHolonomic; // true if back motors were given to init()
+
+/**
+ * Return the number of motor writes made during the last chassis tick.
+ * Commands that have not changed are not resent.
+ */
+uint32_t getWrites();
+
+/**
+ * Return the number of motor writes made since the program started
+ */
+uint32_t getTotalWrites();
+
+/**
+ * Return the filtered battery voltage (V) used to compensate voltage commands
+ */
+double getBatteryVoltage();
+
+/**
+ * Return the fraction of full speed and acceleration the drive is limited to
+ * because its motors are hot, see power::getDerating()
+ */
+double getDerating();
+
+/**
+ * Resend the next motor commands even if unchanged. Call after commanding
+ * the chassis motors directly.
+ */
+void invalidateOutput();
 
 /**
  * Set the brake mode for all chassis motors
@@ -24,46 +133,81 @@ bool settled();
 
 /**
  * Wait for the chassis to complete the current movement
+ *
+ * THRU movements complete as soon as the robot is within exit_error of the
+ * target or crosses the line through the target perpendicular to the path,
+ * allowing consecutive movements to be chained without stopping.
  */
 void waitUntilFinished(double exit_error);
 
+/**
+ * A movement target {x, y} or {x, y, theta}, stored without allocating
+ */
+class Target {
+public:
+	Target(std::initializer_list<double> values) {
+		for (double v : values)
+			if (count < 3)
+				this->values[count++] = v;
+	}
+#ifndef ARMS_STATIC
+	Target(const std::vector<double>& values) {
+		for (double v : values)
+			if (count < 3)
+				this->values[count++] = v;
+	}
+#endif
+
+	size_t size() const {
+		return count;
+	}
+
+	double at(size_t i) const {
+		return i < count ? values[i] : 0;
+	}
+
+private:
+	double values[3] = {0, 0, 0};
+	size_t count = 0;
+};
+
 /**
  * Perform 2D chassis movement
  */
-void move(std::vector<double> target, double max, double exit_error,
+MoveHandle move(Target target, double max, double exit_error,
           double lp, double ap, MoveFlags = NONE);
-void move(std::vector<double> target, double max, double exit_error,
+MoveHandle move(Target target, double max, double exit_error,
           MoveFlags = NONE);
-void move(std::vector<double> target, double max, MoveFlags = NONE);
-void move(std::vector<double> target, MoveFlags = NONE);
+MoveHandle move(Target target, double max, MoveFlags = NONE);
+MoveHandle move(Target target, MoveFlags = NONE);
 
 /**
  * Perform 1D chassis movement
  */
-void move(double target, double max, double exit_error,
+MoveHandle move(double target, double max, double exit_error,
           double lp, double ap, MoveFlags = NONE);
-void move(double target, double max, double exit_error,
+MoveHandle move(double target, double max, double exit_error,
           MoveFlags = NONE);
-void move(double target, double max, MoveFlags = NONE);
-void move(double target, MoveFlags = NONE);
+MoveHandle move(double target, double max, MoveFlags = NONE);
+MoveHandle move(double target, MoveFlags = NONE);
 
 /**
  * Perform a turn movement
  */
-void turn(double target, double max, double exit_error, double ap,
+MoveHandle turn(double target, double max, double exit_error, double ap,
           MoveFlags = NONE);
-void turn(double target, double max, double exit_error, MoveFlags = NONE);
-void turn(double target, double max, MoveFlags = NONE);
-void turn(double target, MoveFlags = NONE);
+MoveHandle turn(double target, double max, double exit_error, MoveFlags = NONE);
+MoveHandle turn(double target, double max, MoveFlags = NONE);
+MoveHandle turn(double target, MoveFlags = NONE);
 
 /**
  * Turn to face a point
  */
-void turn(Point target, double max, double exit_error, double ap,
+MoveHandle turn(Point target, double max, double exit_error, double ap,
           MoveFlags = NONE);
-void turn(Point target, double max, double exit_error, MoveFlags = NONE);
-void turn(Point target, double max, MoveFlags = NONE);
-void turn(Point target, MoveFlags = NONE);
+MoveHandle turn(Point target, double max, double exit_error, MoveFlags = NONE);
+MoveHandle turn(Point target, double max, MoveFlags = NONE);
+MoveHandle turn(Point target, MoveFlags = NONE);
 
 /**
  * Assign a power to the left and right motors
@@ -75,14 +219,25 @@ void tank(double left, double right, bool velocity = false);
  */
 void arcade(double vertical, double horizontal, bool velocity = false);
 
+/**
+ * Assign a forward, strafe (positive to the left) and turn (positive
+ * counterclockwise) power to a holonomic drive. If field is true the forward
+ * and strafe powers are along the field x and y axes instead.
+ */
+void holonomic(double forward, double strafe, double turn, bool field = false);
+
 /**
  * initialize the chassis
  */
 void init(std::initializer_list<int8_t> leftMotors,
           std::initializer_list<int8_t> rightMotors, pros::motor_gearset_e_t gearset,
-          double slew_step, double linear_exit_error, double angular_exit_error, 
-          double settle_thresh_linear, double settle_thresh_angular,
-          int settle_time);
+          double max_velocity, double drive_width, double max_accel,
+          double max_decel, double max_angular_accel,
+          double linear_exit_error, double angular_exit_error,
+          double chain_exit_radius, double settle_thresh_linear, double settle_thresh_angular,
+          int settle_time, double nominal_voltage,
+          std::initializer_list<int8_t> leftBackMotors = {},
+          std::initializer_list<int8_t> rightBackMotors = {});
 
 } // namespace arms::chassis
 
@@ -12,6 +12,8 @@ namespace arms {
 // Negative numbers mean reversed motor
 #define LEFT_MOTORS 1, 2
 #define RIGHT_MOTORS -3, -4
+#define BACK_LEFT_MOTORS       // Back wheels of an X-drive or mecanum drive, the motors
+#define BACK_RIGHT_MOTORS      // above are then the front wheels. Empty for tank drives
 #define GEARSET pros::E_MOTOR_GEAR_200 // RPM of chassis motors
 
 // Ticks per inch
@@ -21,20 +23,37 @@ namespace arms {
 // Tracking wheel distances
 #define TRACK_WIDTH 0 		  // The distance between left and right wheels (or tracker wheels)
 #define MIDDLE_DISTANCE 0     // Distance from middle wheel to the robot turning center
+#define ODOM_SUBSTEPS 1       // Sub-steps per odometry update, raise for fast robots
 
 // Sensors
-#define IMU_PORT 0                           // Port 0 for disabled
+#define IMU_PORTS 0                          // Port of each imu, port 0 for disabled
+#define GPS_PORT 0                           // Port 0 for disabled
+#define GPS_OFFSET 0, 0                      // x, y of the gps relative to the tracking center (in), x forward
 #define ENCODER_PORTS 0, 0, 0                // Port 0 for disabled,
 #define EXPANDER_PORT 0                      // Port 0 for disabled
 #define ENCODER_TYPE arms::odom::ENCODER_ADI // The type of encoders
 
+// Relocalization
+#define FIELD_WALLS {-72, -72}, {72, 72} // Opposite corners of the field walls in the odom frame, centered as in the GPS frame
+#define DISTANCE_SENSORS                 // {port, x, y, angle} of each distance sensor, e.g. {5, 0, 6, 90}
+#define RELOCALIZE_CONTINUOUS false      // Correct the position whenever a wall is seen
+#define MCL_PARTICLES 0                  // Particles for Monte Carlo localization, 0 to disable
+
 // Movement tuning
-#define SLEW_STEP 8          // Smaller number = more slew
+#define MAX_VELOCITY 60      // robot speed at full power (in/s)
+#define DRIVE_WIDTH 12       // distance between the left and right drive wheels
+#define MAX_ACCEL 120        // linear acceleration limit (in/s^2), 0 to disable
+#define MAX_DECEL 200        // linear deceleration limit (in/s^2), 0 to disable
+#define MAX_ANGULAR_ACCEL 20 // angular acceleration limit (rad/s^2), 0 to disable
 #define LINEAR_EXIT_ERROR 1  // default exit distance for linear movements
 #define ANGULAR_EXIT_ERROR 1 // default exit distance for angular movements
+#define CHAIN_EXIT_RADIUS 6  // default exit distance for chained (THRU) movements
 #define SETTLE_THRESH_LINEAR .5      // amount of linear movement for settling
 #define SETTLE_THRESH_ANGULAR 1      // amount of angular movement for settling
 #define SETTLE_TIME 250      // amount of time to count as settled
+#define NOMINAL_VOLTAGE 0    // battery voltage applied at full power, e.g. 11.5, 0 to disable
+#define CURRENT_BUDGET 0     // total motor current (mA), 0 to disable
+#define POWER_BUDGET 0       // total motor power (W), 0 to disable
 #define LINEAR_KP 1
 #define LINEAR_KI 0
 #define LINEAR_KD 0
@@ -44,6 +63,9 @@ namespace arms {
 #define ANGULAR_KD 0
 #define MIN_ERROR 5          // Minimum distance to target before angular componenet is disabled
 #define LEAD_PCT .6			 // Go-to-pose lead distance ratio (0-1)
+#define VELOCITY_KF 1        // wheel velocity loop feedforward
+#define VELOCITY_KP 0        // wheel velocity loop gains, 0 to disable the loop
+#define VELOCITY_KI 0
 
 // Auton selector configuration constants
 #define AUTONS "Front", "Back", "Do Nothing" // Names of autonomi, up to 10
@@ -53,18 +75,28 @@ namespace arms {
 // Initializer
 inline void init() {
 
-	chassis::init({LEFT_MOTORS}, {RIGHT_MOTORS}, GEARSET, SLEW_STEP, LINEAR_EXIT_ERROR,
-	              ANGULAR_EXIT_ERROR, SETTLE_THRESH_LINEAR, SETTLE_THRESH_ANGULAR, SETTLE_TIME);
+	power::init(CURRENT_BUDGET, POWER_BUDGET);
+
+	chassis::init({LEFT_MOTORS}, {RIGHT_MOTORS}, GEARSET, MAX_VELOCITY, DRIVE_WIDTH,
+	              MAX_ACCEL, MAX_DECEL, MAX_ANGULAR_ACCEL, LINEAR_EXIT_ERROR,
+	              ANGULAR_EXIT_ERROR, CHAIN_EXIT_RADIUS, SETTLE_THRESH_LINEAR, SETTLE_THRESH_ANGULAR, SETTLE_TIME, NOMINAL_VOLTAGE,
+	              {BACK_LEFT_MOTORS}, {BACK_RIGHT_MOTORS});
 
-	odom::init(ODOM_DEBUG, ENCODER_TYPE, {ENCODER_PORTS}, EXPANDER_PORT, IMU_PORT,
+	odom::init(ODOM_DEBUG, ENCODER_TYPE, {ENCODER_PORTS}, EXPANDER_PORT, {IMU_PORTS},
 	           TRACK_WIDTH, MIDDLE_DISTANCE, TPI,
-	           MIDDLE_TPI);
+	           MIDDLE_TPI, ODOM_SUBSTEPS, GPS_PORT, {GPS_OFFSET});
 
-	pid::init(LINEAR_KP, LINEAR_KI, LINEAR_KD, ANGULAR_KP, ANGULAR_KI, ANGULAR_KD, TRACKING_KP, MIN_ERROR, LEAD_PCT);
+	field::addRectangle(FIELD_WALLS);
+	odom::initRelocalization({DISTANCE_SENSORS}, RELOCALIZE_CONTINUOUS, MCL_PARTICLES);
+
+	pid::init(LINEAR_KP, LINEAR_KI, LINEAR_KD, ANGULAR_KP, ANGULAR_KI, ANGULAR_KD, TRACKING_KP, MIN_ERROR, LEAD_PCT,
+	          VELOCITY_KF, VELOCITY_KP, VELOCITY_KI);
 
 	const char* b[] = {AUTONS, ""};
 	selector::init(HUE, DEFAULT, b);
 
+	memory::lock(); // allocations after this are counted in static mode
+
 }
 
 } // namespace arms
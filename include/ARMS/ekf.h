@@ -0,0 +1,68 @@
+#ifndef _ARMS_EKF_H_
+#define _ARMS_EKF_H_
+
+#include <array>
+
+namespace arms::ekf {
+
+/**
+ * Extended Kalman filter over the robot pose (x, y, heading). The filter is
+ * fixed size. Positions are in inches and headings in radians,
+ * counterclockwise positive.
+ */
+
+typedef std::array<std::array<double, 3>, 3> Matrix3;
+
+/**
+ * Reset the pose estimate and its variances
+ */
+void reset(double x, double y, double theta, double pos_var = 0,
+           double ang_var = 0);
+
+/**
+ * Advance the estimate by a step of robot relative motion. local_x and local_y
+ * are the displacement along the chord of the step, delta_theta the change in
+ * heading, and q_lin and q_ang the variance added to the position and heading.
+ */
+void predict(double local_x, double local_y, double delta_theta, double q_lin,
+             double q_ang);
+
+/**
+ * Correct the estimate with an absolute pose measurement and its variances.
+ * Each component is gated, returning the number of components accepted.
+ */
+int updatePose(double x, double y, double theta, double pos_var,
+               double ang_var);
+
+/**
+ * Correct the heading with an absolute heading measurement, returning true if
+ * it passed the gate
+ */
+bool updateHeading(double theta, double ang_var);
+
+/**
+ * Correct the estimate with a scalar measurement that is a linear function
+ * h of the pose, given the innovation (measured - h * pose) and its variance.
+ * Returns true if the measurement passed the gate.
+ */
+bool updateLinear(double hx, double hy, double htheta, double innovation,
+                  double var);
+
+/**
+ * Move the pose estimate without changing its covariance
+ */
+void shift(double dx, double dy, double dtheta);
+
+/**
+ * Return the pose estimate as {x, y, theta}
+ */
+std::array<double, 3> getState();
+
+/**
+ * Return the covariance of the pose estimate
+ */
+Matrix3 getCovariance();
+
+} // namespace arms::ekf
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _ARMS_FIELD_H_
+#define _ARMS_FIELD_H_
+
+#include "ARMS/point.h"
+
+namespace arms::field {
+
+// maximum number of wall segments in the field map
+#define MAX_SEGMENTS 32
+
+/**
+ * The field map is a table of wall segments in the odometry frame, stored as
+ * a structure of arrays so that rays can be tested against every segment in
+ * a tight loop. Segment i runs from (x[i], y[i]) to (x[i] + dx[i], y[i] +
+ * dy[i]).
+ */
+typedef struct segments_s {
+	int count = 0;
+	float x[MAX_SEGMENTS];
+	float y[MAX_SEGMENTS];
+	float dx[MAX_SEGMENTS];
+	float dy[MAX_SEGMENTS];
+} segments_s_t;
+
+extern segments_s_t segments;
+
+/**
+ * Add a wall segment between two points, returning false if the map is full
+ */
+bool addSegment(Point a, Point b);
+
+/**
+ * Add the four walls of a rectangle given two opposite corners
+ */
+void addRectangle(Point a, Point b);
+
+/**
+ * Remove all wall segments
+ */
+void clear();
+
+/**
+ * Return the distance along a ray from (x, y) in direction theta (radians) to
+ * the nearest wall, or a negative number if no wall is hit. If segment is not
+ * null it is set to the index of the wall that was hit.
+ */
+double raycast(double x, double y, double theta, int* segment = nullptr);
+
+} // namespace arms::field
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef _ARMS_MCL_H_
+#define _ARMS_MCL_H_
+
+#include <array>
+
+namespace arms::mcl {
+
+// size of the particle pool
+#define MAX_PARTICLES 512
+
+/**
+ * Monte Carlo localization against the field map in ARMS/field.h. Particles
+ * are kept in a fixed pool laid out as a structure of arrays, and ray casting
+ * runs over all particles for each wall so that the inner loops are branch
+ * free and can be vectorized.
+ */
+typedef struct particles_s {
+	int count = 0;
+	float x[MAX_PARTICLES];
+	float y[MAX_PARTICLES];
+	float theta[MAX_PARTICLES];
+	float weight[MAX_PARTICLES];
+} particles_s_t;
+
+extern particles_s_t particles;
+
+/**
+ * Spread count particles around a pose with the given standard deviations
+ */
+void init(int count, double x, double y, double theta, double sigma_xy,
+          double sigma_theta);
+
+/**
+ * Move every particle by a step of robot relative motion, adding noise
+ * proportional to the step
+ */
+void predict(double local_x, double local_y, double delta_theta,
+             double noise_lin, double noise_ang);
+
+/**
+ * Weight the particles by a distance sensor reading. The sensor is mounted at
+ * (x, y, theta) relative to the robot and measured the given distance, with
+ * standard deviation sigma.
+ */
+void update(double x, double y, double theta, double measured, double sigma);
+
+/**
+ * Normalize the weights and resample if the effective number of particles
+ * has dropped below half
+ */
+void resample();
+
+/**
+ * Return the weighted mean pose {x, y, theta} of the particles
+ */
+std::array<double, 3> estimate();
+
+/**
+ * Return the weighted variance of the particle positions
+ */
+double variance();
+
+} // namespace arms::mcl
+
+#endif
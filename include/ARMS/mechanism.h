@@ -0,0 +1,130 @@
+#ifndef _ARMS_MECHANISM_H_
+#define _ARMS_MECHANISM_H_
+
+#include "api.h"
+
+namespace arms::mechanism {
+
+// maximum number of mechanisms
+#define MAX_MECHANISMS 8
+
+typedef enum MechanismMode {
+	MECHANISM_DISABLED, // motors stopped
+	MECHANISM_VOLTAGE,  // open loop power
+	MECHANISM_POSITION, // profiled move to a position
+	MECHANISM_VELOCITY  // hold a velocity
+} MechanismMode_e_t;
+
+// Time spent updating a mechanism in the chassis task
+typedef struct stats_s {
+	uint32_t last;  // last update (us)
+	uint32_t max;   // longest update (us)
+	double mean;    // average update (us)
+	uint32_t ticks; // number of updates
+} stats_s_t;
+
+/**
+ * Mechanisms such as lifts, intakes and flywheels are run by the chassis task
+ * on the same 10 ms tick as the drive, so they need no task of their own.
+ * Positions are in motor encoder units (degrees by default) and velocities
+ * in rpm. Their motors share the power budget and are derated when hot.
+ */
+typedef struct mechanism_s {
+	std::shared_ptr<pros::Motor_Group> motors;
+	MechanismMode_e_t mode = MECHANISM_DISABLED;
+	int load = -1; // index in the power budget
+
+	// gains, in percent per unit of error, and percent per rpm for kF
+	double kP, kI, kD, kF;
+
+	// limits
+	double min_position = -INFINITY;
+	double max_position = INFINITY;
+	double max_velocity = INFINITY; // profile speed (rpm)
+	double max_accel = INFINITY;    // profile acceleration (rpm/s)
+	double tolerance = 5;           // error counted as at target
+
+	// target and profile state
+	double target = 0;      // position, velocity or power
+	double setpoint = 0;    // profiled position
+	double setpoint_v = 0;  // profiled velocity (rpm)
+	double integral = 0;
+	double prev_error = 0;
+	double measured = 0;    // last measured position or velocity
+
+	stats_s_t stats;
+} mechanism_s_t;
+
+/**
+ * Register a mechanism, returning its id or -1 if the table is full. The
+ * gains act on position error in position mode and velocity error in
+ * velocity mode. In static mode mechanisms must be added before arms::init().
+ */
+int add(std::initializer_list<int8_t> ports, pros::motor_gearset_e_t gearset,
+        double kP, double kI = 0, double kD = 0, double kF = 0);
+
+/**
+ * Keep the mechanism between two positions, in every mode
+ */
+void setLimits(int id, double min_position, double max_position);
+
+/**
+ * Limit the speed (rpm) and acceleration (rpm/s) of position moves and
+ * velocity changes
+ */
+void setProfile(int id, double max_velocity, double max_accel);
+
+/**
+ * Set the error counted as at target, in position units or rpm
+ */
+void setTolerance(int id, double tolerance);
+
+/**
+ * Move to a position along a trapezoidal profile
+ */
+void moveTo(int id, double position);
+
+/**
+ * Accelerate to and hold a velocity (rpm)
+ */
+void setVelocity(int id, double rpm);
+
+/**
+ * Drive the motors at a fixed power (percent)
+ */
+void setVoltage(int id, double percent);
+
+/**
+ * Stop the mechanism
+ */
+void stop(int id);
+
+/**
+ * Return true once the mechanism has reached its target
+ */
+bool atTarget(int id);
+
+/**
+ * Wait up to timeout ms for the mechanism to reach its target, returning
+ * true if it did
+ */
+bool waitUntilAtTarget(int id, uint32_t timeout = TIMEOUT_MAX);
+
+/**
+ * Return the measured position of the mechanism
+ */
+double getPosition(int id);
+
+/**
+ * Return the timing statistics of the mechanism
+ */
+stats_s_t getStats(int id);
+
+/**
+ * Update every mechanism over dt seconds, called by the chassis task
+ */
+void update(double dt);
+
+} // namespace arms::mechanism
+
+#endif
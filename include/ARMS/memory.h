@@ -0,0 +1,59 @@
+#ifndef _ARMS_MEMORY_H_
+#define _ARMS_MEMORY_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace arms::memory {
+
+// devices of each type that can be created in static mode, enough motor
+// groups for a holonomic drive and MAX_MECHANISMS mechanisms
+#define MAX_DEVICES 12
+
+#ifdef ARMS_STATIC
+// fixed storage for the devices of one type
+template <class T> struct Pool {
+	alignas(T) static inline unsigned char slots[MAX_DEVICES][sizeof(T)];
+	static inline int used = 0;
+};
+#endif
+
+/**
+ * Create a device. Building with ARMS_STATIC defined (for example by adding
+ * -DARMS_STATIC to EXTRA_CXXFLAGS in the Makefile) places every device in a
+ * fixed pool for its type, returning nullptr once the pool is full. The
+ * returned pointer does not own the device, so no control block is allocated
+ * either. Otherwise the device is allocated with make_shared.
+ */
+template <class T, class... Args> std::shared_ptr<T> make(Args&&... args) {
+#ifdef ARMS_STATIC
+	if (Pool<T>::used >= MAX_DEVICES) {
+		printf("ARMS ERROR: device pool full, raise MAX_DEVICES\n");
+		return nullptr;
+	}
+	T* device = new (Pool<T>::slots[Pool<T>::used++])
+	    T(std::forward<Args>(args)...);
+	return std::shared_ptr<T>(std::shared_ptr<T>(), device);
+#else
+	return std::make_shared<T>(std::forward<Args>(args)...);
+#endif
+}
+
+/**
+ * Mark the end of initialization. In static mode, every dynamic allocation
+ * made afterwards is counted.
+ */
+void lock();
+
+/**
+ * Return the number of dynamic allocations made since lock(), always 0
+ * unless built with ARMS_STATIC
+ */
+uint32_t getAllocations();
+
+} // namespace arms::memory
+
+#endif
@@ -1,11 +1,25 @@
 #ifndef _ARMS_ODOM_H_
 #define _ARMS_ODOM_H_
 
+#include "ARMS/ekf.h"
+#include "ARMS/mcl.h"
 #include "ARMS/point.h"
 #include <memory>
 
 namespace arms::odom {
 
+// number of poses kept for latency compensation, one per odom update
+#define POSE_HISTORY 128
+
+// maximum number of imus fused into the heading
+#define MAX_IMUS 4
+
+// maximum number of distance sensors used for relocalization
+#define MAX_DISTANCE_SENSORS 4
+
+// where the calibrated tracking wheel geometry is saved
+#define CALIBRATION_FILE "/usd/arms_odom.txt"
+
 typedef enum EncoderType { ENCODER_ADI, ENCODER_ROTATION } EncoderType_e_t;
 
 // Odom Configuration
@@ -18,8 +32,38 @@ typedef struct config_data_s {
     EncoderType_e_t encoderType;
 } config_data_s_t;
 
+// Events detected by the odometry, as a bit mask
+typedef enum OdomEvent {
+	EVENT_SLIP = 1,     // the drive wheels slipped
+	EVENT_COLLISION = 2 // the robot was hit or ran into something
+} OdomEvent_e_t;
+
+// Odometry sensors, as a bit mask
+typedef enum Sensor {
+	SENSOR_LEFT = 1,   // left tracking wheel
+	SENSOR_RIGHT = 2,  // right tracking wheel
+	SENSOR_MIDDLE = 4, // middle tracking wheel
+	SENSOR_IMU = 8     // every imu
+} Sensor_e_t;
+
+// A pose at a point in time, in inches and degrees
+typedef struct pose_s {
+	uint32_t time; // ms since program start, as returned by pros::millis()
+	double x;
+	double y;
+	double theta;
+} pose_s_t;
+
+// A velocity or acceleration, in inches and degrees per second (squared)
+typedef struct motion_s {
+	double x;
+	double y;
+	double theta;
+} motion_s_t;
+
 // sensors
-extern std::shared_ptr<pros::Imu> imu;
+extern std::shared_ptr<pros::Imu> imu; // the first imu
+extern std::shared_ptr<pros::Gps> gps;
 
 /**
  * Return the left encoder position
@@ -36,6 +80,63 @@ double getRightEncoder();
  */
 double getMiddleEncoder();
 
+/**
+ * Return a mask of the sensors that have failed. The odometry falls back to
+ * the drive motor encoders for failed left or right tracking wheels, except
+ * on holonomic drives, and to the wheels when every imu has failed, without
+ * moving the pose.
+ */
+int getFailedSensors();
+
+/**
+ * Return a mask of the events detected at or after the time since (ms), as
+ * returned by pros::millis()
+ */
+int getEvents(uint32_t since = 0);
+
+/**
+ * Return true if the robot has been still long enough that imu drift is being
+ * estimated and the heading is held
+ */
+bool isStationary();
+
+/**
+ * Return the estimated drift of an imu in degrees per second, which is
+ * removed from its readings
+ */
+double getImuBias(int index = 0);
+
+/**
+ * Return true once the sensors have started up and the odometry is running
+ */
+bool isReady();
+
+/**
+ * Wait up to timeout ms for the odometry to be ready, returning true if it is
+ */
+bool waitUntilReady(uint32_t timeout = TIMEOUT_MAX);
+
+/**
+ * Print how long each part of the startup took to the terminal
+ */
+void printStartupReport();
+
+/**
+ * Calibrate the tracking wheel geometry by spinning turns full turns in
+ * place, half each way, at speed (percent), and fitting the encoder ticks
+ * against the imu rotation by least squares. The track width and tracking
+ * wheel offsets are saved to the SD card and loaded by init().
+ */
+bool calibrateTurn(int turns = 4, double speed = 40);
+
+/**
+ * Calibrate the ticks per inch by driving distance inches alternately forward
+ * and back runs times, measuring the motion with a distance sensor facing a
+ * wall ahead or behind. The result is saved to the SD card and loaded by
+ * init(). Run before calibrateTurn(), which uses the ticks per inch.
+ */
+bool calibrateDrive(double distance = 24, int runs = 4, double speed = 30);
+
 /**
  * Return the robot position coordinates
  */
@@ -46,6 +147,24 @@ Point getPosition();
  */
 double getHeading(bool radians = false);
 
+/**
+ * Return the filtered robot velocity in the field frame, or in the body frame
+ * (x forward, y left) if body is true. The estimate lags by about 50 ms.
+ */
+motion_s_t getVelocity(bool body = false, bool radians = false);
+
+/**
+ * Return the filtered robot acceleration in the field frame, or in the body
+ * frame if body is true. The estimate lags by about 150 ms.
+ */
+motion_s_t getAcceleration(bool body = false, bool radians = false);
+
+/**
+ * Return the covariance of the robot pose estimate {x, y, heading}, in
+ * inches and radians
+ */
+ekf::Matrix3 getCovariance();
+
 /**
  * Reset the robot position to a desired coordinate
  */
@@ -56,6 +175,38 @@ void reset(Point point = {0, 0});
  */
 void reset(Point point, double angle);
 
+/**
+ * Return the robot pose at a time within the last POSE_HISTORY updates,
+ * interpolating between updates. Times outside the history return the
+ * oldest or newest pose.
+ */
+pose_s_t getPoseAt(uint32_t time);
+
+/**
+ * Correct the robot pose with a measurement taken at an earlier time. The
+ * path travelled since then is moved so that it starts at the measured pose,
+ * which compensates for the latency of the measurement.
+ */
+void correct(pose_s_t measured);
+void correct(uint32_t time, Point position);
+
+/**
+ * Correct the robot position using the distance sensors and the field walls,
+ * returning the number of sensor readings that were used
+ */
+int relocalize();
+
+/**
+ * Configure the distance sensors used for relocalization. Each sensor is
+ * given as {port, x, y, angle}, its position in inches and direction in
+ * degrees relative to the tracking center, x forward and counterclockwise
+ * positive. If continuous is true, the walls seen by the sensors correct the
+ * position while driving. If particles is non-zero, a particle filter with
+ * that many particles also tracks the position against the field map.
+ */
+void initRelocalization(std::initializer_list<std::array<double, 4>> sensors,
+                        bool continuous, int particles = 0);
+
 /**
  * Return the angle between the robots current heading and a point
  */
@@ -68,10 +219,25 @@ double getDistanceError(Point point);
 
 /**
  * Initialize the odometry
+ *
+ * The pose is estimated with an EKF that uses the tracking wheels and imu
+ * for prediction and the GPS sensor, if one is given, for correction. With
+ * a GPS sensor the pose is in the GPS field frame: the first fix sets the
+ * pose, and later resets should be given in that frame. gpsOffset is the
+ * position {x, y} of the GPS sensor relative to the tracking center, in
+ * inches with x forward and y left.
+ *
+ * Devices are started without blocking; the imus calibrate in the background
+ * and the odometry starts once they are done, see waitUntilReady().
+ *
+ * Geometry saved to the SD card by calibrateTurn() and calibrateDrive()
+ * replaces the track width, middle distance and tpi given here.
  */
 void init(bool debug, EncoderType_e_t encoderType, std::array<int, 3> encoderPorts,
-          int expanderPort, int imuPort, double track_width,
-          double middle_distance, double tpi, double middle_tpi);
+          int expanderPort, std::initializer_list<int> imuPorts,
+          double track_width, double middle_distance, double tpi, double middle_tpi,
+          int substeps = 1, int gpsPort = 0,
+          std::array<double, 2> gpsOffset = {0, 0});
 
 } // namespace arms::odom
 
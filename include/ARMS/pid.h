@@ -20,10 +20,14 @@ extern double angularKI;
 extern double angularKD;
 extern double trackingKP;
 extern double minError;
+extern double velocityKF;
+extern double velocityKP;
+extern double velocityKI;
 
 // integral
 extern double in_lin;
 extern double in_ang;
+extern double in_vel[2]; // left, right
 
 // targets
 extern double angularTarget;
@@ -39,9 +43,18 @@ extern bool canReverse;
 std::array<double, 2> translational();
 std::array<double, 2> angular();
 
+// translational movement for holonomic drives, returning the robot relative
+// {forward, left, counterclockwise} speeds
+std::array<double, 3> holonomic();
+
+// inner wheel velocity loop, target and measured speeds in percent of the
+// maximum motor velocity
+double velocity(double target, double measured, double* in);
+
 // initializer
 void init(double linearKP, double linearKI, double linearKD, double angularKP,
-          double angularKI, double angularKD, double trackingKP, double minError, double leadPct);
+          double angularKI, double angularKD, double trackingKP, double minError, double leadPct,
+          double velocityKF, double velocityKP, double velocityKI);
 
 } // namespace arms::pid
 
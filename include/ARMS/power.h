@@ -0,0 +1,80 @@
+#ifndef _ARMS_POWER_H_
+#define _ARMS_POWER_H_
+
+#include "api.h"
+#include <memory>
+
+namespace arms::power {
+
+// maximum number of motor groups sharing the budget, enough for a holonomic
+// drive and MAX_MECHANISMS mechanisms
+#define MAX_LOADS 12
+
+// maximum number of motors in a load with a thermal model
+#define MAX_LOAD_MOTORS 4
+
+/**
+ * A shared current and power budget for the motors. The chassis and any
+ * registered mechanisms are loads; their draw is measured every chassis tick
+ * and, when the total is over budget, a common scale factor is lowered until
+ * it fits. Every load multiplies its commands by the scale, so the drive keeps
+ * its curvature and the mechanisms their relative speeds.
+ */
+typedef struct load_s {
+	std::shared_ptr<pros::Motor_Group> motors;
+	double current = 0; // last measured draw (mA)
+	double power = 0;   // last measured power (W)
+
+	// thermal model of each motor, see getDerating()
+	double temperature[MAX_LOAD_MOTORS]; // estimated temperature (C)
+	bool modelled[MAX_LOAD_MOTORS];      // temperature has been initialized
+	double derating = 1;                 // for the hottest motor, 0 to 1
+} load_s_t;
+
+extern load_s_t loads[MAX_LOADS];
+extern int loadCount;
+
+/**
+ * Add a motor group to the budget, returning its index or -1 if full
+ */
+int addLoad(std::shared_ptr<pros::Motor_Group> motors);
+
+/**
+ * Measure every load and update the scale factor. Called by the chassis task.
+ */
+void update();
+
+/**
+ * Return the factor, from 0 to 1, that every load should scale its commands by
+ */
+double getScale();
+
+/**
+ * Return the total measured current (mA) and power (W) of every load
+ */
+double getCurrent();
+double getPower();
+
+/**
+ * Return the fraction of full speed and acceleration that a load, or every
+ * load if index is -1, can sustain before its motors overheat. Each motor's
+ * temperature is estimated from its current draw and corrected by its
+ * reported temperature, and the derating starts ahead of the firmware's
+ * current limit at 55 C so that movements slow down predictably rather than
+ * losing power partway through.
+ */
+double getDerating(int index = -1);
+
+/**
+ * Return the estimated temperature (C) of a motor in a load
+ */
+double getTemperature(int index, int motor);
+
+/**
+ * Set the current (mA) and power (W) budgets, 0 disables either
+ */
+void init(double current_budget, double power_budget);
+
+} // namespace arms::power
+
+#endif
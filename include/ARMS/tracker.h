@@ -0,0 +1,38 @@
+#ifndef _ARMS_TRACKER_H_
+#define _ARMS_TRACKER_H_
+
+namespace arms::tracker {
+
+/**
+ * Alpha-beta-gamma filter, which tracks the position, velocity and
+ * acceleration of a noisy position signal.
+ */
+typedef struct tracker_s {
+	double position = 0;
+	double velocity = 0;
+	double acceleration = 0;
+	bool valid = false; // set by the first update
+} tracker_s_t;
+
+typedef struct gains_s {
+	double alpha, beta, gamma;
+} gains_s_t;
+
+/**
+ * Gains used for the odometry velocity and acceleration. Larger gains follow
+ * changes with less lag but pass more encoder noise: with these gains the
+ * velocity reaches a step change in about 5 updates, overshooting by up to a
+ * third, and the acceleration settles in about 15. Constant acceleration is
+ * tracked without lag.
+ */
+const gains_s_t odom_gains = {.5, .15, .01};
+
+/**
+ * Update the filter with a position measured dt seconds after the last. The
+ * first update, or one with no elapsed time, starts the filter at rest.
+ */
+void update(tracker_s_t& t, double measured, double dt, gains_s_t gains);
+
+} // namespace arms::tracker
+
+#endif
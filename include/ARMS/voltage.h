@@ -0,0 +1,27 @@
+#ifndef _ARMS_VOLTAGE_H_
+#define _ARMS_VOLTAGE_H_
+
+namespace arms::voltage {
+
+/**
+ * Battery voltage compensation. Voltage commands are duty cycles of the
+ * battery voltage, so they are scaled to apply the same voltage at any
+ * charge.
+ */
+
+/**
+ * Return a command (percent) scaled to apply nominal volts at 100% from a
+ * battery at battery volts. A nominal or battery voltage of 0 leaves the
+ * command unchanged.
+ */
+double compensate(double command, double nominal, double battery);
+
+/**
+ * Return a filtered battery voltage updated with a new reading, starting
+ * from the reading if filtered is 0. Readings out of range are ignored.
+ */
+double filter(double filtered, double reading, double gain);
+
+} // namespace arms::voltage
+
+#endif
@@ -0,0 +1,41 @@
+#include "ARMS/arc.h"
+
+#include <cmath>
+
+namespace arms::arc {
+
+// a Taylor series is used near zero, where the ratio approaches 1
+double chordRatio(double x) {
+	if (fabs(x) < 1e-2)
+		return 1 - x * x / 24 + x * x * x * x / 1920;
+	return 2 * sin(x / 2) / x;
+}
+
+std::array<double, 2> chord(double delta_right, double delta_middle,
+                            double delta_angle, double right_offset,
+                            double middle_distance) {
+	double r = chordRatio(delta_angle);
+	return {(delta_right - right_offset * delta_angle) * r,
+	        (delta_middle + middle_distance * delta_angle) * r};
+}
+
+void apply(std::array<double, 3>& pose, double local_x, double local_y,
+           double delta_angle) {
+	double p = pose[2] + delta_angle / 2.0; // direction of the chord
+	pose[0] += cos(p) * local_x - sin(p) * local_y;
+	pose[1] += sin(p) * local_x + cos(p) * local_y;
+	pose[2] += delta_angle;
+}
+
+double substepWeight(int i, int n, double delta, double prev_delta) {
+	if (n == 1)
+		return 1;
+
+	double ramp = 0;
+	if (fabs(delta) > 1e-9)
+		ramp = fmax(fmin((delta - prev_delta) / fabs(delta), 1), -1);
+
+	return (1 + ramp * ((i + .5) / n - .5)) / n;
+}
+
+} // namespace arms::arc
@@ -9,13 +9,27 @@ namespace arms::chassis {
 // chassis motors
 std::shared_ptr<pros::Motor_Group> leftMotors;
 std::shared_ptr<pros::Motor_Group> rightMotors;
-
-// slew control (autonomous only)
-double slew_step; // smaller number = more slew
+std::shared_ptr<pros::Motor_Group> leftBackMotors;  // holonomic drives only
+std::shared_ptr<pros::Motor_Group> rightBackMotors; // holonomic drives only
+bool isHolonomic = false; // X-drive or mecanum, the left and right motors
+                          // are then the front wheels
+double maxRPM; // free speed of the chassis motors
+
+// control loop periods (ms), the outer loop must be a multiple of the inner
+const uint32_t outer_period = 10;
+const uint32_t inner_period = 5;
+
+// acceleration limiting
+double max_velocity;      // robot speed at full power (in/s)
+double drive_width;       // distance between the left and right wheels (in)
+double max_accel;         // linear acceleration limit (in/s^2)
+double max_decel;         // linear deceleration limit (in/s^2)
+double max_angular_accel; // angular acceleration limit (rad/s^2)
 
 // default exit error
 double linear_exit_error;
 double angular_exit_error;
+double chain_exit_radius; // exit radius for chained (THRU) movements
 
 // settling
 double settle_thresh_linear;
@@ -26,29 +40,178 @@ int settle_time;
 double maxSpeed = 100;
 double leftPrev = 0;
 double rightPrev = 0;
+double strafePrev = 0;
 double leftDriveSpeed = 0;
 double rightDriveSpeed = 0;
+double strafeDriveSpeed = 0; // holonomic drives, positive to the left
+
+// position of the robot when the current movement started
+Point moveStart{0, 0};
+
+// movement tracking, guarded by the chassis mutex so that a new movement
+// only takes effect at a tick boundary
+pros::Mutex mutex;
+uint32_t moveId = 0;
+MoveStatus_e_t moveStatus[MOVE_HISTORY];
+double moveProgress[MOVE_HISTORY];
+double moveExitError = 0;
+double moveStartError = 0;
+uint32_t moveStartTime = 0;
+int moveAbortEvents = 0; // odometry events that abort the current movement
+
+// actions attached to movements, evaluated by the chassis task
+typedef enum TriggerType {
+	TRIGGER_PROGRESS,
+	TRIGGER_DISTANCE,
+	TRIGGER_TIME
+} TriggerType_e_t;
+
+typedef struct trigger_s {
+	uint32_t moveId = 0; // 0 for an empty slot
+	TriggerType_e_t type;
+	double value;
+	void (*action)();
+} trigger_s_t;
+
+trigger_s_t triggers[MAX_TRIGGERS];
 
 /**************************************************/
-// motor control
+// motor output
+// The last command sent to each motor group is cached so that a group is only
+// written when its command changes. Commands are resent periodically in case
+// a motor was unplugged and lost its command.
+typedef struct output_s {
+	bool valid = false;    // the cache matches the motors
+	bool velocity = false; // command is a velocity (rpm) rather than mV
+	int32_t value = 0;
+	uint32_t time = 0; // when the command was last sent (ms)
+	int motors = 0;    // number of motors in the group
+} output_s_t;
+
+output_s_t leftOutput;
+output_s_t rightOutput;
+output_s_t leftBackOutput;
+output_s_t rightBackOutput;
+const uint32_t output_refresh = 100; // ms between repeated commands
+
+// battery compensation, see ARMS/voltage.h. The reading is filtered over
+// about half a second so that sag under load does not feed back into the
+// commands.
+double nominal_voltage = 0;        // voltage at 100% (V), 0 to disable
+double battery_voltage = 0;        // filtered battery voltage (V)
+const double battery_filter = .02; // per outer loop update
+uint32_t tickWrites = 0;             // motor writes during this tick
+uint32_t lastTickWrites = 0;         // motor writes during the last tick
+uint32_t totalWrites = 0;
+
+output_s_t& outputFor(std::shared_ptr<pros::Motor_Group> motor) {
+	if (motor == leftMotors)
+		return leftOutput;
+	if (motor == rightMotors)
+		return rightOutput;
+	return motor == leftBackMotors ? leftBackOutput : rightBackOutput;
+}
+
 void motorMove(std::shared_ptr<pros::Motor_Group> motor, double speed,
                bool velocity) {
+	output_s_t& out = outputFor(motor);
+	if (!velocity)
+		speed = voltage::compensate(speed, nominal_voltage, battery_voltage);
+	int32_t value = velocity ? round(speed * maxRPM / 100)
+	                         : round(fmin(fmax(speed * 120, -12000), 12000));
+	uint32_t now = pros::millis();
+
+	if (out.valid && out.velocity == velocity && out.value == value &&
+	    now - out.time < output_refresh)
+		return;
+
 	if (velocity)
-		motor->move_velocity(speed * (double)motor->get_gearing()[0] / 100);
+		motor->move_velocity(value);
 	else
-		motor->move_voltage(speed * 120);
+		motor->move_voltage(value);
 
-	if (motor == leftMotors)
-		leftPrev = speed;
-	else
-		rightPrev = speed;
+	out = {true, velocity, value, now, out.motors};
+	tickWrites += out.motors;
+	totalWrites += out.motors;
+}
+
+// end a chassis tick, publishing the number of writes made during it
+void endTick() {
+	lastTickWrites = tickWrites;
+	tickWrites = 0;
+}
+
+void invalidateOutput() {
+	leftOutput.valid = false;
+	rightOutput.valid = false;
+	leftBackOutput.valid = false;
+	rightBackOutput.valid = false;
+}
+
+// filter the battery voltage, called every outer loop update
+void updateBattery() {
+	double reading = pros::battery::get_voltage() / 1000.0;
+	battery_voltage = voltage::filter(battery_voltage, reading, battery_filter);
+}
+
+double getBatteryVoltage() {
+	return battery_voltage;
+}
+
+uint32_t getWrites() {
+	return lastTickWrites;
+}
+
+uint32_t getTotalWrites() {
+	return totalWrites;
 }
 
 void setBrakeMode(pros::motor_brake_mode_e_t b) {
 	leftMotors->set_brake_modes((pros::motor_brake_mode_e_t)b);
 	rightMotors->set_brake_modes((pros::motor_brake_mode_e_t)b);
+	invalidateOutput(); // always apply the new brake mode with a stop command
 	motorMove(leftMotors, 0, true);
 	motorMove(rightMotors, 0, true);
+	if (isHolonomic) {
+		leftBackMotors->set_brake_modes(b);
+		rightBackMotors->set_brake_modes(b);
+		motorMove(leftBackMotors, 0, true);
+		motorMove(rightBackMotors, 0, true);
+	}
+	leftPrev = 0;
+	rightPrev = 0;
+	strafePrev = 0;
+}
+
+// return the average velocity of a motor group in percent of the free speed
+double getVelocity(std::shared_ptr<pros::Motor_Group> motor) {
+	// read each motor rather than through the group, which returns a vector
+	int count = motor->size();
+	double sum = 0;
+	for (int i = 0; i < count; i++)
+		sum += (*motor)[i].get_actual_velocity();
+	return sum / count / maxRPM * 100;
+}
+
+// power budget loads of the drive motor groups, -1 if unused
+int powerLoads[4] = {-1, -1, -1, -1};
+
+double getDerating() {
+	double derating = 1;
+	for (int load : powerLoads)
+		if (load >= 0)
+			derating = fmin(derating, power::getDerating(load));
+	return derating;
+}
+
+// return the forward velocity of one side of the drive in percent. On a
+// holonomic drive the front and back wheels are averaged, which cancels out
+// strafing.
+double getSideVelocity(std::shared_ptr<pros::Motor_Group> front,
+                       std::shared_ptr<pros::Motor_Group> back) {
+	if (!isHolonomic)
+		return getVelocity(front);
+	return (getVelocity(front) + getVelocity(back)) / 2;
 }
 
 /**************************************************/
@@ -62,19 +225,38 @@ double limitSpeed(double speed, double max) {
 	return speed;
 }
 
-double slew(double target_speed, double step, double current_speed) {
-
-	if (fabs(current_speed) > fabs(target_speed))
-		step = 200;
-
-	if (target_speed > current_speed + step)
-		current_speed += step;
-	else if (target_speed < current_speed - step)
-		current_speed -= step;
-	else
-		current_speed = target_speed;
-
-	return current_speed;
+// limit the change from the current to the target speeds {left, right,
+// strafe} so that the linear and angular acceleration limits are respected
+// over dt seconds. Every component is scaled by the same factor, which
+// preserves the curvature and direction of the commanded path. A limit of 0
+// disables it.
+std::array<double, 3> limitAccel(std::array<double, 3> target,
+                                 std::array<double, 3> current, double dt) {
+	double k = max_velocity / 100; // percent to in/s
+
+	// convert to linear (in/s) and angular (rad/s) velocity
+	double vx0 = (current[0] + current[1]) / 2 * k;
+	double vx1 = (target[0] + target[1]) / 2 * k;
+	double vy0 = current[2] * k;
+	double vy1 = target[2] * k;
+	double w0 = (current[1] - current[0]) * k / drive_width;
+	double w1 = (target[1] - target[0]) * k / drive_width;
+
+	// decelerating if the robot is slowing down or changing direction
+	double dv = hypot(vx1 - vx0, vy1 - vy0);
+	bool decel = hypot(vx1, vy1) < hypot(vx0, vy0) || vx0 * vx1 + vy0 * vy1 < 0;
+	double lin_limit = (decel ? max_decel : max_accel) * dt;
+	double ang_limit = max_angular_accel * dt;
+
+	double scale = 1;
+	if (lin_limit > 0 && dv > lin_limit)
+		scale = lin_limit / dv;
+	if (ang_limit > 0 && fabs(w1 - w0) > ang_limit)
+		scale = fmin(scale, ang_limit / fabs(w1 - w0));
+
+	return {current[0] + (target[0] - current[0]) * scale,
+	        current[1] + (target[1] - current[1]) * scale,
+	        current[2] + (target[2] - current[2]) * scale};
 }
 
 /**************************************************/
@@ -108,37 +290,274 @@ bool settled() {
 		return false;
 }
 
-void waitUntilFinished(double exit_error) {
-	pros::delay(400); // minimum movement time
+// return true if the robot has crossed the line through the target point
+// that is perpendicular to the path of the current movement
+bool passedTarget() {
+	Point pos = odom::getPosition();
+	Point to_target = pid::pointTarget - pos;
+	Point path = pid::pointTarget - moveStart;
+	return dot(to_target, path) < 0;
+}
+
+// return the error of the current movement, in inches for translational
+// movements and degrees for angular movements
+double moveError() {
+	if (pid::mode == TRANSLATIONAL)
+		return odom::getDistanceError(pid::pointTarget);
+	return fabs(odom::getHeading() - pid::angularTarget);
+}
+
+// return true if the current movement has met its exit conditions, called
+// from the chassis task once per tick
+bool finished() {
+	uint32_t elapsed = pros::millis() - moveStartTime;
+
+	// chained movements exit as soon as the waypoint is reached or passed so
+	// the next movement picks up at the current speed
+	if (pid::mode == TRANSLATIONAL && pid::thru) {
+		if (moveError() <= moveExitError || passedTarget())
+			return true;
+		return elapsed > 400 && settled();
+	}
+
+	if (elapsed < 400) // minimum movement time
+		return false;
+
+	if (settled())
+		return true;
+
 	switch (pid::mode) {
 	case TRANSLATIONAL:
-		while (odom::getDistanceError(pid::pointTarget) > exit_error &&
-		       !settled()) {
-			pros::delay(10);
-		}
+		if (moveError() > moveExitError)
+			return false;
 
 		// if doing a pose movement, make sure we are at the target theta
-		if (pid::angularTarget != 361) {
-			while (fabs(odom::getHeading() - pid::angularTarget) > exit_error &&
-			       !settled())
-				pros::delay(10);
-		}
+		if (pid::angularTarget != 361)
+			return fabs(remainder(odom::getHeading() - pid::angularTarget, 360)) <=
+			       moveExitError;
 
-		break;
+		return true;
 	case ANGULAR:
-		while (fabs(odom::getHeading() - pid::angularTarget) > exit_error &&
-		       !settled())
-			pros::delay(10);
-		break;
+		return moveError() <= moveExitError;
 	}
+
+	return true;
+}
+
+// update the progress of the running movement and check its exit conditions.
+// Must be called with the chassis mutex held.
+void updateMove() {
+	if (pid::mode == DISABLE ||
+	    moveStatus[moveId % MOVE_HISTORY] != MOVE_RUNNING)
+		return;
+
+	double p = moveStartError > 0 ? 1 - moveError() / moveStartError : 1;
+	moveProgress[moveId % MOVE_HISTORY] = fmin(fmax(p, 0), 1);
+
+	if (finished()) {
+		moveProgress[moveId % MOVE_HISTORY] = 1;
+		moveStatus[moveId % MOVE_HISTORY] = MOVE_DONE;
+	} else if (moveAbortEvents & odom::getEvents(moveStartTime)) {
+		// stop under the acceleration limits
+		moveStatus[moveId % MOVE_HISTORY] = MOVE_ABORTED;
+		pid::mode = DISABLE;
+		leftDriveSpeed = 0;
+		rightDriveSpeed = 0;
+		strafeDriveSpeed = 0;
+	}
+}
+
+// end the running movement, if any, with the given status. Must be called
+// with the chassis mutex held.
+void endMove(MoveStatus_e_t status) {
+	if (moveStatus[moveId % MOVE_HISTORY] == MOVE_RUNNING)
+		moveStatus[moveId % MOVE_HISTORY] = status;
+}
+
+// begin a new movement, preempting the previous one. Must be called with the
+// chassis mutex held.
+MoveHandle startMove(double exit_error) {
+	endMove(MOVE_PREEMPTED);
+	moveId++;
+	moveStatus[moveId % MOVE_HISTORY] = MOVE_RUNNING;
+	moveExitError = exit_error;
+	moveStartTime = pros::millis();
+	moveAbortEvents = 0;
+	moveStartError = moveError();
+	moveProgress[moveId % MOVE_HISTORY] = 0;
+	return MoveHandle(moveId);
+}
+
+void waitUntilFinished(double exit_error) {
+	mutex.take();
+	moveExitError = exit_error;
+	mutex.give();
+	MoveHandle(moveId).wait();
+}
+
+/**************************************************/
+// movement handle
+// return true if the status of a movement is still in the history
+bool known(uint32_t id) {
+	return id != 0 && id <= moveId && moveId - id < MOVE_HISTORY;
+}
+
+MoveStatus_e_t MoveHandle::status() {
+	if (!known(id))
+		return MOVE_PREEMPTED; // unknown or expired movement
+	return moveStatus[id % MOVE_HISTORY];
+}
+
+void MoveHandle::wait() {
+	while (status() == MOVE_RUNNING)
+		pros::delay(10);
+}
+
+bool MoveHandle::wait_for(uint32_t ms) {
+	uint32_t start = pros::millis();
+	while (status() == MOVE_RUNNING) {
+		if (pros::millis() - start >= ms)
+			return false;
+		pros::delay(10);
+	}
+	return true;
+}
+
+void MoveHandle::cancel() {
+	mutex.take();
+	bool running = (id == moveId && status() == MOVE_RUNNING);
+	if (running) {
+		endMove(MOVE_CANCELLED);
+		pid::mode = DISABLE;
+	}
+	mutex.give();
+
+	if (running)
+		setBrakeMode(pros::E_MOTOR_BRAKE_BRAKE);
+}
+
+double MoveHandle::progress() {
+	if (!known(id))
+		return 0;
+	return moveProgress[id % MOVE_HISTORY];
+}
+
+// add a trigger to a movement's trigger table
+void addTrigger(uint32_t id, TriggerType_e_t type, double value,
+                void (*action)()) {
+	mutex.take();
+	bool added = false;
+	for (int i = 0; i < MAX_TRIGGERS && !added; i++) {
+		// reuse slots belonging to movements that are no longer current
+		if (triggers[i].moveId != moveId) {
+			triggers[i] = {id, type, value, action};
+			added = true;
+		}
+	}
+	mutex.give();
+
+	if (!added)
+		printf("ARMS ERROR: trigger table full, action dropped\n");
+}
+
+MoveHandle& MoveHandle::at_progress(double fraction, void (*action)()) {
+	addTrigger(id, TRIGGER_PROGRESS, fraction, action);
+	return *this;
+}
+
+MoveHandle& MoveHandle::within(double error, void (*action)()) {
+	addTrigger(id, TRIGGER_DISTANCE, error, action);
+	return *this;
+}
+
+MoveHandle& MoveHandle::after(uint32_t ms, void (*action)()) {
+	addTrigger(id, TRIGGER_TIME, ms, action);
+	return *this;
+}
+
+MoveHandle& MoveHandle::abort_on(int events) {
+	mutex.take();
+	if (id == moveId)
+		moveAbortEvents |= events;
+	mutex.give();
+	return *this;
+}
+
+// collect the actions of the current movement's triggers that have fired
+// and free their slots, returning the number of actions collected. Must be
+// called with the chassis mutex held.
+int dueTriggers(void (*due[MAX_TRIGGERS])()) {
+	MoveStatus_e_t status = moveStatus[moveId % MOVE_HISTORY];
+	if (status == MOVE_CANCELLED || status == MOVE_PREEMPTED ||
+	    status == MOVE_ABORTED)
+		return 0;
+
+	int count = 0;
+	for (int i = 0; i < MAX_TRIGGERS; i++) {
+		trigger_s_t& t = triggers[i];
+		if (t.moveId != moveId || t.moveId == 0)
+			continue;
+
+		bool fire = false;
+		switch (t.type) {
+		case TRIGGER_PROGRESS:
+			fire = moveProgress[moveId % MOVE_HISTORY] >= t.value;
+			break;
+		case TRIGGER_DISTANCE:
+			fire = status == MOVE_DONE || moveError() <= t.value;
+			break;
+		case TRIGGER_TIME:
+			// a movement that finished early drops its remaining time triggers
+			if (status != MOVE_RUNNING) {
+				t.moveId = 0;
+				continue;
+			}
+			fire = pros::millis() - moveStartTime >= t.value;
+			break;
+		}
+
+		if (fire) {
+			due[count++] = t.action;
+			t.moveId = 0;
+		}
+	}
+
+	return count;
+}
+
+// handle of the chassis task, which runs trigger actions
+pros::task_t chassis_task = nullptr;
+
+// return true if called from the chassis task, where waiting for a movement
+// would block the task that updates it
+bool inChassisTask() {
+	return chassis_task != nullptr && pros::c::task_get_current() == chassis_task;
+}
+
+// complete a blocking movement once its handle is no longer running
+void finishMove(MoveHandle handle, MoveFlags flags) {
+	handle.wait();
+
+	// leave the chassis alone if another movement has since been started
+	mutex.take();
+	bool done = (handle.id == moveId && handle.status() == MOVE_DONE);
+	if (done)
+		pid::mode = DISABLE;
+	mutex.give();
+
+	if (done && !(flags & THRU))
+		chassis::setBrakeMode(pros::E_MOTOR_BRAKE_BRAKE);
 }
 
 /**************************************************/
 // 2D movement
-void move(std::vector<double> target, double max, double exit_error, double lp,
-          double ap, MoveFlags flags) {
-	pid::mode = TRANSLATIONAL;
+double defaultExitError(MoveFlags flags) {
+	return (flags & THRU) ? chain_exit_radius : linear_exit_error;
+}
 
+MoveHandle move(Target target, double max, double exit_error,
+                double lp, double ap, MoveFlags flags) {
+	odom::waitUntilReady(); // movements need a valid position
 	double x = target.at(0);
 	double y = target.at(1);
 	double theta =
@@ -155,8 +574,17 @@ void move(std::vector<double> target, double max, double exit_error, double lp,
 			theta += fmod(odom::getHeading(), 360);
 	}
 
+	// holonomic drives hold their heading unless given one. Their controller
+	// wraps the heading error, so the heading is held as it is.
+	if (isHolonomic && target.size() != 3)
+		theta = odom::getHeading();
+
+	mutex.take();
+
+	pid::mode = TRANSLATIONAL;
 	pid::pointTarget = Point{x, y};
 	pid::angularTarget = theta;
+	moveStart = odom::getPosition();
 
 	maxSpeed = max;
 	pid::linearKP = lp;
@@ -169,47 +597,50 @@ void move(std::vector<double> target, double max, double exit_error, double lp,
 	pid::in_lin = 0;
 	pid::in_ang = 0;
 
-	if (!(flags & ASYNC)) {
-		waitUntilFinished(exit_error);
-		pid::mode = DISABLE;
-		if (!(flags & THRU))
-			chassis::setBrakeMode(pros::E_MOTOR_BRAKE_BRAKE);
-	}
+	MoveHandle handle = startMove(exit_error);
+	mutex.give();
+
+	if (!(flags & ASYNC) && !inChassisTask())
+		finishMove(handle, flags);
+
+	return handle;
 }
 
-void move(std::vector<double> target, double max, double exit_error,
-          MoveFlags flags) {
-	move(target, max, exit_error, -1, -1, flags);
+MoveHandle move(Target target, double max, double exit_error,
+                MoveFlags flags) {
+	return move(target, max, exit_error, -1, -1, flags);
 }
 
-void move(std::vector<double> target, double max, MoveFlags flags) {
-	move(target, max, linear_exit_error, -1, -1, flags);
+MoveHandle move(Target target, double max, MoveFlags flags) {
+	return move(target, max, defaultExitError(flags), -1, -1, flags);
 }
 
-void move(std::vector<double> target, MoveFlags flags) {
-	move(target, 100, linear_exit_error, -1, -1, flags);
+MoveHandle move(Target target, MoveFlags flags) {
+	return move(target, 100, defaultExitError(flags), -1, -1, flags);
 }
 
 /**************************************************/
 // 1D movement
-void move(double target, double max, double exit_error, MoveFlags flags) {
-	move({target, 0}, max, exit_error, -1, -1, flags | RELATIVE);
+MoveHandle move(double target, double max, double exit_error,
+                MoveFlags flags) {
+	return move({target, 0}, max, exit_error, -1, -1, flags | RELATIVE);
 }
 
-void move(double target, double max, MoveFlags flags) {
-	move({target, 0}, max, linear_exit_error, -1, -1, flags | RELATIVE);
+MoveHandle move(double target, double max, MoveFlags flags) {
+	return move({target, 0}, max, defaultExitError(flags), -1, -1,
+	            flags | RELATIVE);
 }
 
-void move(double target, MoveFlags flags) {
-	move({target, 0}, 100, linear_exit_error, -1, -1, flags | RELATIVE);
+MoveHandle move(double target, MoveFlags flags) {
+	return move({target, 0}, 100, defaultExitError(flags), -1, -1,
+	            flags | RELATIVE);
 }
 
 /**************************************************/
 // rotational movement
-void turn(double target, double max, double exit_error, double ap,
-          MoveFlags flags) {
-	pid::mode = ANGULAR;
-
+MoveHandle turn(double target, double max, double exit_error, double ap,
+                MoveFlags flags) {
+	odom::waitUntilReady(); // movements need a valid position
 	double bounded_heading = (int)(odom::getHeading()) % 360;
 
 	double diff = target - bounded_heading;
@@ -225,77 +656,191 @@ void turn(double target, double max, double exit_error, double ap,
 
 	double true_target = diff + odom::getHeading();
 
+	mutex.take();
+
+	pid::mode = ANGULAR;
 	pid::angularTarget = true_target;
 	maxSpeed = max;
 	pid::angularKP = ap;
 	pid::in_ang = 0; // reset the integral value to zero
 
-	if (!(flags & ASYNC)) {
-		waitUntilFinished(exit_error);
-		pid::mode = DISABLE;
-		if (!(flags & THRU))
-			chassis::setBrakeMode(pros::E_MOTOR_BRAKE_BRAKE);
-	}
+	MoveHandle handle = startMove(exit_error);
+	mutex.give();
+
+	if (!(flags & ASYNC) && !inChassisTask())
+		finishMove(handle, flags);
+
+	return handle;
 }
 
-void turn(double target, double max, double exit_error, MoveFlags flags) {
-	turn(target, max, exit_error, -1, flags);
+MoveHandle turn(double target, double max, double exit_error,
+                MoveFlags flags) {
+	return turn(target, max, exit_error, -1, flags);
 }
 
-void turn(double target, double max, MoveFlags flags) {
-	turn(target, max, angular_exit_error, -1, flags);
+MoveHandle turn(double target, double max, MoveFlags flags) {
+	return turn(target, max, angular_exit_error, -1, flags);
 }
 
-void turn(double target, MoveFlags flags) {
-	turn(target, 100, angular_exit_error, -1, flags);
+MoveHandle turn(double target, MoveFlags flags) {
+	return turn(target, 100, angular_exit_error, -1, flags);
 }
 
 /**************************************************/
 // turn to point
-void turn(Point target, double max, double exit_error, double ap,
-          MoveFlags flags) {
+MoveHandle turn(Point target, double max, double exit_error, double ap,
+                MoveFlags flags) {
 	double angle_error = odom::getAngleError(target);
-	turn(angle_error, max, exit_error, ap, flags);
+	return turn(angle_error, max, exit_error, ap, flags);
 }
 
-void turn(Point target, double max, double exit_error, MoveFlags flags) {
-	turn(target, max, exit_error, -1, flags);
+MoveHandle turn(Point target, double max, double exit_error,
+                MoveFlags flags) {
+	return turn(target, max, exit_error, -1, flags);
 }
 
-void turn(Point target, double max, MoveFlags flags) {
-	turn(target, max, angular_exit_error, -1, flags);
+MoveHandle turn(Point target, double max, MoveFlags flags) {
+	return turn(target, max, angular_exit_error, -1, flags);
 }
 
-void turn(Point target, MoveFlags flags) {
-	turn(target, 100, angular_exit_error, -1, flags);
+MoveHandle turn(Point target, MoveFlags flags) {
+	return turn(target, 100, angular_exit_error, -1, flags);
 }
 
 /**************************************************/
 // task control
-int chassisTask() {
-	while (1) {
-		pros::delay(10);
+// outer loop, computes the left, right and strafe speed targets for the
+// current movement or driver input
+std::array<double, 3> outerLoop() {
+	std::array<double, 3> speeds = {0, 0, 0}; // left, right, strafe
+
+	updateBattery();
+
+	mutex.take();
+
+	if (pid::mode == TRANSLATIONAL && isHolonomic) {
+		std::array<double, 3> v = pid::holonomic(); // forward, left, turn
+		speeds = {v[0] - v[2], v[0] + v[2], v[1]};
+	} else if (pid::mode == TRANSLATIONAL) {
+		std::array<double, 2> s = pid::translational();
+		speeds = {s[0], s[1], 0};
+	} else if (pid::mode == ANGULAR) {
+		std::array<double, 2> s = pid::angular();
+		speeds = {s[0], s[1], 0};
+	} else {
+		speeds = {leftDriveSpeed, rightDriveSpeed, strafeDriveSpeed};
+	}
 
-		std::array<double, 2> speeds = {0, 0}; // left, right
+	updateMove();
+
+	void (*due[MAX_TRIGGERS])();
+	int dueCount = dueTriggers(due);
+
+	mutex.give();
+
+	// run actions outside of the mutex so they may start new movements
+	for (int i = 0; i < dueCount; i++)
+		due[i]();
+
+	// speed limiting
+	speeds[0] = limitSpeed(speeds[0], maxSpeed);
+	speeds[1] = limitSpeed(speeds[1], maxSpeed);
+	speeds[2] = limitSpeed(speeds[2], maxSpeed);
+
+	// stay within the power budget, scaling every wheel alike to keep the
+	// curvature
+	power::update();
+	for (double& speed : speeds)
+		speed *= power::getScale();
+
+	// slow down ahead of the drive motors overheating, the same way
+	double derating = getDerating();
+	double fastest = fmax(fmax(fabs(speeds[0]), fabs(speeds[1])), fabs(speeds[2]));
+	if (fastest > 100 * derating)
+		for (double& speed : speeds)
+			speed *= 100 * derating / fastest;
+
+	// acceleration limiting, using the measured time since the last update
+	static uint32_t prev_time = pros::micros();
+	uint32_t time = pros::micros();
+	double dt = fmin((time - prev_time) / 1e6, .05);
+	prev_time = time;
+
+	// a derated drive also accelerates more gently, shortening dt scales every
+	// acceleration limit alike
+	speeds = limitAccel(speeds, {leftPrev, rightPrev, strafePrev},
+	                    dt * derating);
+	leftPrev = speeds[0];
+	rightPrev = speeds[1];
+	strafePrev = speeds[2];
+
+	return speeds;
+}
 
-		if (pid::mode == TRANSLATIONAL)
-			speeds = pid::translational();
-		else if (pid::mode == ANGULAR)
-			speeds = pid::angular();
-		else
-			speeds = {leftDriveSpeed, rightDriveSpeed};
+// inner loop, tracks the wheel speed targets using the motor encoder
+// velocities. Only used during autonomous movements when the velocity gains
+// are set, otherwise the targets are output directly. Strafing is not
+// measured and only gets the feedforward.
+std::array<double, 3> innerLoop(std::array<double, 3> targets) {
+	if (pid::mode == DISABLE || (pid::velocityKP == 0 && pid::velocityKI == 0)) {
+		pid::in_vel[0] = 0;
+		pid::in_vel[1] = 0;
+		return targets;
+	}
 
-		// speed limiting
-		speeds[0] = limitSpeed(speeds[0], maxSpeed);
-		speeds[1] = limitSpeed(speeds[1], maxSpeed);
+	return {pid::velocity(targets[0], getSideVelocity(leftMotors, leftBackMotors),
+	                      &pid::in_vel[0]),
+	        pid::velocity(targets[1],
+	                      getSideVelocity(rightMotors, rightBackMotors),
+	                      &pid::in_vel[1]),
+	        targets[2] * pid::velocityKF};
+}
 
-		// slew
-		speeds[0] = slew(speeds[0], slew_step, leftPrev);
-		speeds[1] = slew(speeds[1], slew_step, rightPrev);
+// send the speeds to the motors. Holonomic wheel speeds are scaled down
+// together if any is out of range, which keeps the direction of motion.
+void output(std::array<double, 3> speeds) {
+	if (!isHolonomic) {
+		motorMove(leftMotors, limitSpeed(speeds[0], 100), false);
+		motorMove(rightMotors, limitSpeed(speeds[1], 100), false);
+		return;
+	}
 
-		// output
-		motorMove(leftMotors, speeds[0], false);
-		motorMove(rightMotors, speeds[1], false);
+	// inverse kinematics, with the rollers at 45 degrees
+	double wheels[4] = {
+	    speeds[0] - speeds[2], // front left
+	    speeds[1] + speeds[2], // front right
+	    speeds[0] + speeds[2], // back left
+	    speeds[1] - speeds[2]  // back right
+	};
+
+	double largest = 100;
+	for (double w : wheels)
+		largest = fmax(largest, fabs(w));
+	for (double& w : wheels)
+		w *= 100 / largest;
+
+	motorMove(leftMotors, wheels[0], false);
+	motorMove(rightMotors, wheels[1], false);
+	motorMove(leftBackMotors, wheels[2], false);
+	motorMove(rightBackMotors, wheels[3], false);
+}
+
+int chassisTask() {
+	std::array<double, 3> targets = {0, 0, 0}; // left, right, strafe
+	uint32_t now = pros::millis();
+	uint32_t tick = 0;
+
+	while (1) {
+		pros::Task::delay_until(&now, inner_period);
+
+		if (tick++ % (outer_period / inner_period) == 0) {
+			targets = outerLoop();
+			mechanism::update(outer_period / 1000.0);
+		}
+
+		// output, skipping unchanged commands
+		output(innerLoop(targets));
+		endTick();
 	}
 }
 
@@ -303,44 +848,114 @@ int chassisTask() {
 // initialization
 void init(std::initializer_list<int8_t> leftMotors,
           std::initializer_list<int8_t> rightMotors,
-          pros::motor_gearset_e_t gearset, double slew_step,
+          pros::motor_gearset_e_t gearset, double max_velocity,
+          double drive_width, double max_accel, double max_decel,
+          double max_angular_accel,
           double linear_exit_error, double angular_exit_error,
-          double settle_thresh_linear, double settle_thresh_angular,
-          int settle_time) {
+          double chain_exit_radius, double settle_thresh_linear, double settle_thresh_angular,
+          int settle_time, double nominal_voltage,
+          std::initializer_list<int8_t> leftBackMotors,
+          std::initializer_list<int8_t> rightBackMotors) {
 
 	// assign constants
-	chassis::slew_step = slew_step;
+	chassis::max_velocity = max_velocity;
+	chassis::drive_width = drive_width;
+	chassis::max_accel = max_accel;
+	chassis::max_decel = max_decel;
+	chassis::max_angular_accel = max_angular_accel;
 	chassis::linear_exit_error = linear_exit_error;
 	chassis::angular_exit_error = angular_exit_error;
+	chassis::chain_exit_radius = chain_exit_radius;
 	chassis::settle_thresh_linear = settle_thresh_linear;
 	chassis::settle_thresh_angular = settle_thresh_angular;
 	chassis::settle_time = settle_time;
+	chassis::nominal_voltage = nominal_voltage;
 
 	// configure chassis motors
 	chassis::leftMotors =
-	    std::make_shared<pros::Motor_Group>(std::vector<int8_t>(leftMotors));
+	    memory::make<pros::Motor_Group>(std::vector<int8_t>(leftMotors));
 	chassis::rightMotors =
-	    std::make_shared<pros::Motor_Group>(std::vector<int8_t>(rightMotors));
+	    memory::make<pros::Motor_Group>(std::vector<int8_t>(rightMotors));
+	if (!chassis::leftMotors || !chassis::rightMotors) {
+		printf("ARMS ERROR: could not create the chassis motors\n");
+		return;
+	}
 	chassis::leftMotors->set_gearing(gearset);
 	chassis::rightMotors->set_gearing(gearset);
+	leftOutput.motors = leftMotors.size();
+	rightOutput.motors = rightMotors.size();
+
+	// back wheels of a holonomic drive
+	chassis::isHolonomic = leftBackMotors.size() && rightBackMotors.size();
+	if (chassis::isHolonomic) {
+		chassis::leftBackMotors = memory::make<pros::Motor_Group>(
+		    std::vector<int8_t>(leftBackMotors));
+		chassis::rightBackMotors = memory::make<pros::Motor_Group>(
+		    std::vector<int8_t>(rightBackMotors));
+		if (!chassis::leftBackMotors || !chassis::rightBackMotors) {
+			printf("ARMS ERROR: could not create the chassis motors\n");
+			return;
+		}
+		chassis::leftBackMotors->set_gearing(gearset);
+		chassis::rightBackMotors->set_gearing(gearset);
+		leftBackOutput.motors = leftBackMotors.size();
+		rightBackOutput.motors = rightBackMotors.size();
+	}
+
+	powerLoads[0] = power::addLoad(chassis::leftMotors);
+	powerLoads[1] = power::addLoad(chassis::rightMotors);
+	if (chassis::isHolonomic) {
+		powerLoads[2] = power::addLoad(chassis::leftBackMotors);
+		powerLoads[3] = power::addLoad(chassis::rightBackMotors);
+	}
+	chassis::maxRPM = gearset == pros::E_MOTOR_GEARSET_36   ? 100
+	                  : gearset == pros::E_MOTOR_GEARSET_06 ? 600
+	                                                        : 200;
 
-	pros::Task chassis_task(chassisTask);
+	chassis_task = pros::Task::create(chassisTask);
 }
 
 /**************************************************/
 // operator control
 void tank(double left_speed, double right_speed, bool velocity) {
+	mutex.take();
+	endMove(MOVE_PREEMPTED);
 	pid::mode = DISABLE; // turns off autonomous tasks
+	mutex.give();
 	maxSpeed = 100;
 	chassis::leftDriveSpeed = left_speed;
 	chassis::rightDriveSpeed = right_speed;
+	chassis::strafeDriveSpeed = 0;
 }
 
 void arcade(double vertical, double horizontal, bool velocity) {
+	mutex.take();
+	endMove(MOVE_PREEMPTED);
 	pid::mode = DISABLE; // turns off autonomous task
+	mutex.give();
 	maxSpeed = 100;
 	chassis::leftDriveSpeed = vertical + horizontal;
 	chassis::rightDriveSpeed = vertical - horizontal;
+	chassis::strafeDriveSpeed = 0;
+}
+
+void holonomic(double forward, double strafe, double turn, bool field) {
+	// rotate field relative input into the robot frame
+	if (field) {
+		double h = odom::getHeading(true);
+		double f = forward * cos(h) + strafe * sin(h);
+		strafe = strafe * cos(h) - forward * sin(h);
+		forward = f;
+	}
+
+	mutex.take();
+	endMove(MOVE_PREEMPTED);
+	pid::mode = DISABLE; // turns off autonomous tasks
+	mutex.give();
+	maxSpeed = 100;
+	chassis::leftDriveSpeed = forward - turn;
+	chassis::rightDriveSpeed = forward + turn;
+	chassis::strafeDriveSpeed = strafe;
 }
 
 } // namespace arms::chassis
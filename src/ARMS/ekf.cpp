@@ -0,0 +1,112 @@
+#include "ARMS/ekf.h"
+
+#include <cmath>
+
+namespace arms::ekf {
+
+// squared number of standard deviations a measurement may be from the
+// estimate before it is rejected as an outlier
+const double gate = 9;
+
+// state and covariance
+std::array<double, 3> s = {0, 0, 0};
+Matrix3 P = {{{0, 0, 0}, {0, 0, 0}, {0, 0, 0}}};
+
+void reset(double x, double y, double theta, double pos_var, double ang_var) {
+	s = {x, y, theta};
+	P = {{{pos_var, 0, 0}, {0, pos_var, 0}, {0, 0, ang_var}}};
+}
+
+void predict(double local_x, double local_y, double delta_theta, double q_lin,
+             double q_ang) {
+	double p = s[2] + delta_theta / 2; // direction of the chord
+	double dx = cos(p) * local_x - sin(p) * local_y;
+	double dy = sin(p) * local_x + cos(p) * local_y;
+
+	s[0] += dx;
+	s[1] += dy;
+	s[2] += delta_theta;
+
+	// P = F * P * F^T + Q, where F is the identity except for the dependence
+	// of the position on the heading: F[0][2] = -dy, F[1][2] = dx
+	Matrix3 FP = P;
+	for (int j = 0; j < 3; j++) {
+		FP[0][j] -= dy * P[2][j];
+		FP[1][j] += dx * P[2][j];
+	}
+	for (int i = 0; i < 3; i++) {
+		P[i][0] = FP[i][0] - FP[i][2] * dy;
+		P[i][1] = FP[i][1] + FP[i][2] * dx;
+		P[i][2] = FP[i][2];
+	}
+
+	P[0][0] += q_lin;
+	P[1][1] += q_lin;
+	P[2][2] += q_ang;
+}
+
+bool updateLinear(double hx, double hy, double htheta, double innovation,
+                  double var) {
+	double H[3] = {hx, hy, htheta};
+
+	// PH = P * H^T, S = H * P * H^T + var
+	double PH[3];
+	for (int i = 0; i < 3; i++)
+		PH[i] = P[i][0] * H[0] + P[i][1] * H[1] + P[i][2] * H[2];
+	double S = H[0] * PH[0] + H[1] * PH[1] + H[2] * PH[2] + var;
+	if (S <= 0 || innovation * innovation / S > gate)
+		return false;
+
+	double K[3];
+	for (int i = 0; i < 3; i++)
+		K[i] = PH[i] / S;
+
+	for (int i = 0; i < 3; i++)
+		s[i] += K[i] * innovation;
+
+	// P = (I - K * H) * P, where H * P = PH^T since P is symmetric
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			P[i][j] -= K[i] * PH[j];
+
+	return true;
+}
+
+// scalar measurement update of a single state component
+bool update(int index, double innovation, double var) {
+	return updateLinear(index == 0, index == 1, index == 2, innovation, var);
+}
+
+// wrap an angle to [-pi, pi]
+double wrap(double a) {
+	return remainder(a, 2 * M_PI);
+}
+
+int updatePose(double x, double y, double theta, double pos_var,
+               double ang_var) {
+	int accepted = 0;
+	accepted += update(0, x - s[0], pos_var);
+	accepted += update(1, y - s[1], pos_var);
+	accepted += update(2, wrap(theta - s[2]), ang_var);
+	return accepted;
+}
+
+bool updateHeading(double theta, double ang_var) {
+	return update(2, wrap(theta - s[2]), ang_var);
+}
+
+void shift(double dx, double dy, double dtheta) {
+	s[0] += dx;
+	s[1] += dy;
+	s[2] += dtheta;
+}
+
+std::array<double, 3> getState() {
+	return s;
+}
+
+Matrix3 getCovariance() {
+	return P;
+}
+
+} // namespace arms::ekf
@@ -0,0 +1,56 @@
+#include "ARMS/field.h"
+
+namespace arms::field {
+
+segments_s_t segments;
+
+bool addSegment(Point a, Point b) {
+	if (segments.count >= MAX_SEGMENTS)
+		return false;
+
+	int i = segments.count++;
+	segments.x[i] = a.x;
+	segments.y[i] = a.y;
+	segments.dx[i] = b.x - a.x;
+	segments.dy[i] = b.y - a.y;
+	return true;
+}
+
+void addRectangle(Point a, Point b) {
+	addSegment({a.x, a.y}, {b.x, a.y});
+	addSegment({b.x, a.y}, {b.x, b.y});
+	addSegment({b.x, b.y}, {a.x, b.y});
+	addSegment({a.x, b.y}, {a.x, a.y});
+}
+
+void clear() {
+	segments.count = 0;
+}
+
+double raycast(double x, double y, double theta, int* segment) {
+	double ux = cos(theta);
+	double uy = sin(theta);
+
+	double nearest = -1;
+	for (int i = 0; i < segments.count; i++) {
+		// solve (x, y) + s * u = segment start + t * segment direction
+		double denom = ux * segments.dy[i] - uy * segments.dx[i];
+		if (fabs(denom) < 1e-9)
+			continue; // parallel
+
+		double wx = segments.x[i] - x;
+		double wy = segments.y[i] - y;
+		double s = (wx * segments.dy[i] - wy * segments.dx[i]) / denom;
+		double t = (wx * uy - wy * ux) / denom;
+
+		if (s > 0 && t >= 0 && t <= 1 && (nearest < 0 || s < nearest)) {
+			nearest = s;
+			if (segment)
+				*segment = i;
+		}
+	}
+
+	return nearest;
+}
+
+} // namespace arms::field
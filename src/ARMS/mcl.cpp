@@ -0,0 +1,205 @@
+#include "ARMS/mcl.h"
+#include "ARMS/field.h"
+
+#include <cmath>
+#include <cstdint>
+
+namespace arms::mcl {
+
+particles_s_t particles;
+
+// scratch buffers for ray casting and resampling
+particles_s_t resampled;
+float ray_x[MAX_PARTICLES];
+float ray_y[MAX_PARTICLES];
+float ray_ux[MAX_PARTICLES];
+float ray_uy[MAX_PARTICLES];
+float ray_dist[MAX_PARTICLES];
+
+// readings further than this from every wall are treated as misses (in)
+const float max_range = 80;
+
+// fraction of readings assumed to be outliers, such as other robots
+const float outlier_ratio = .1;
+
+/**************************************************/
+// random numbers
+uint32_t rng_state = 0x12345678;
+
+// xorshift32, uniform on [0, 1)
+float uniform() {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return (rng_state >> 8) * (1.0f / 16777216.0f);
+}
+
+// approximately normal with unit variance, from the sum of uniforms
+float gaussian() {
+	return (uniform() + uniform() + uniform() + uniform() - 2) * 1.7320508f;
+}
+
+/**************************************************/
+// filter
+void init(int count, double x, double y, double theta, double sigma_xy,
+          double sigma_theta) {
+	if (count > MAX_PARTICLES)
+		count = MAX_PARTICLES;
+
+	particles.count = count;
+	for (int i = 0; i < count; i++) {
+		particles.x[i] = x + gaussian() * sigma_xy;
+		particles.y[i] = y + gaussian() * sigma_xy;
+		particles.theta[i] = theta + gaussian() * sigma_theta;
+		particles.weight[i] = 1.0f / count;
+	}
+}
+
+void predict(double local_x, double local_y, double delta_theta,
+             double noise_lin, double noise_ang) {
+	float distance = fabs(local_x) + fabs(local_y);
+	float sigma_lin = noise_lin * distance;
+	float sigma_ang = noise_ang * fabs(delta_theta) + noise_lin * distance * .01;
+
+	for (int i = 0; i < particles.count; i++) {
+		float lx = local_x + gaussian() * sigma_lin;
+		float ly = local_y + gaussian() * sigma_lin;
+		float dt = delta_theta + gaussian() * sigma_ang;
+
+		float p = particles.theta[i] + dt / 2; // direction of the chord
+		float c = cosf(p);
+		float s = sinf(p);
+		particles.x[i] += c * lx - s * ly;
+		particles.y[i] += s * lx + c * ly;
+		particles.theta[i] += dt;
+	}
+}
+
+// cast a ray from every particle, storing the distance to the nearest wall
+// in ray_dist. The loop over particles is innermost and free of branches so
+// it can be vectorized; parallel walls divide by zero and fail the hit test.
+void raycastAll(int n) {
+	for (int i = 0; i < n; i++)
+		ray_dist[i] = max_range;
+
+	for (int w = 0; w < field::segments.count; w++) {
+		float sx = field::segments.x[w];
+		float sy = field::segments.y[w];
+		float sdx = field::segments.dx[w];
+		float sdy = field::segments.dy[w];
+
+		for (int i = 0; i < n; i++) {
+			float denom = ray_ux[i] * sdy - ray_uy[i] * sdx;
+			float wx = sx - ray_x[i];
+			float wy = sy - ray_y[i];
+			float inv = 1.0f / denom;
+			float s = (wx * sdy - wy * sdx) * inv;
+			float t = (wx * ray_uy[i] - wy * ray_ux[i]) * inv;
+			bool hit = s > 0 && t >= 0 && t <= 1 && s < ray_dist[i];
+			ray_dist[i] = hit ? s : ray_dist[i];
+		}
+	}
+}
+
+void update(double x, double y, double theta, double measured, double sigma) {
+	int n = particles.count;
+
+	// pose of the sensor for each particle
+	float mc = cos(theta);
+	float ms = sin(theta);
+	for (int i = 0; i < n; i++) {
+		float c = cosf(particles.theta[i]);
+		float s = sinf(particles.theta[i]);
+		ray_x[i] = particles.x[i] + c * x - s * y;
+		ray_y[i] = particles.y[i] + s * x + c * y;
+		ray_ux[i] = c * mc - s * ms;
+		ray_uy[i] = s * mc + c * ms;
+	}
+
+	raycastAll(n);
+
+	// gaussian likelihood mixed with a uniform floor for outliers
+	float k = -.5f / (sigma * sigma);
+	float floor = outlier_ratio / max_range;
+	for (int i = 0; i < n; i++) {
+		float e = ray_dist[i] - measured;
+		particles.weight[i] *= (1 - outlier_ratio) * expf(k * e * e) + floor;
+	}
+}
+
+void resample() {
+	int n = particles.count;
+
+	float total = 0;
+	for (int i = 0; i < n; i++)
+		total += particles.weight[i];
+	if (!(total > 0)) {
+		// every particle is impossible, keep them all with equal weights
+		for (int i = 0; i < n; i++)
+			particles.weight[i] = 1.0f / n;
+		return;
+	}
+
+	float sum_sq = 0;
+	for (int i = 0; i < n; i++) {
+		particles.weight[i] /= total;
+		sum_sq += particles.weight[i] * particles.weight[i];
+	}
+
+	// effective number of particles
+	if (1 / sum_sq >= n / 2)
+		return;
+
+	// low variance resampling
+	float step = 1.0f / n;
+	float target = uniform() * step;
+	float cumulative = particles.weight[0];
+	int j = 0;
+	for (int i = 0; i < n; i++) {
+		while (target > cumulative && j < n - 1)
+			cumulative += particles.weight[++j];
+		resampled.x[i] = particles.x[j];
+		resampled.y[i] = particles.y[j];
+		resampled.theta[i] = particles.theta[j];
+		resampled.weight[i] = step;
+		target += step;
+	}
+
+	resampled.count = n;
+	particles = resampled;
+}
+
+std::array<double, 3> estimate() {
+	double total = 0, x = 0, y = 0, c = 0, s = 0;
+	for (int i = 0; i < particles.count; i++) {
+		double w = particles.weight[i];
+		total += w;
+		x += w * particles.x[i];
+		y += w * particles.y[i];
+		c += w * cos(particles.theta[i]);
+		s += w * sin(particles.theta[i]);
+	}
+	if (!(total > 0))
+		return {0, 0, 0};
+
+	// keep the heading continuous with the particles rather than wrapped
+	double mean = atan2(s, c);
+	double ref = particles.theta[0];
+	mean += 2 * M_PI * round((ref - mean) / (2 * M_PI));
+
+	return {x / total, y / total, mean};
+}
+
+double variance() {
+	std::array<double, 3> mean = estimate();
+	double total = 0, v = 0;
+	for (int i = 0; i < particles.count; i++) {
+		double dx = particles.x[i] - mean[0];
+		double dy = particles.y[i] - mean[1];
+		total += particles.weight[i];
+		v += particles.weight[i] * (dx * dx + dy * dy) / 2;
+	}
+	return total > 0 ? v / total : 0;
+}
+
+} // namespace arms::mcl
@@ -0,0 +1,265 @@
+#include "ARMS/api.h"
+#include "api.h"
+
+namespace arms::mechanism {
+
+static_assert(MAX_DEVICES >= MAX_MECHANISMS + 4,
+              "static mode needs a motor group for every mechanism and the "
+              "four holonomic drive groups");
+static_assert(MAX_LOADS >= MAX_MECHANISMS + 4,
+              "the power budget needs a load for every mechanism and the four "
+              "holonomic drive groups");
+
+mechanism_s_t mechanisms[MAX_MECHANISMS];
+int mechanismCount = 0;
+
+// guards the table, which is written by user tasks and read by the chassis
+// task
+pros::Mutex mutex;
+
+// return true if id is a registered mechanism, printing an error otherwise
+bool valid(int id) {
+	if (id >= 0 && id < mechanismCount)
+		return true;
+	printf("ARMS ERROR: unknown mechanism %d\n", id);
+	return false;
+}
+
+int add(std::initializer_list<int8_t> ports, pros::motor_gearset_e_t gearset,
+        double kP, double kI, double kD, double kF) {
+	if (mechanismCount >= MAX_MECHANISMS) {
+		printf("ARMS ERROR: too many mechanisms\n");
+		return -1;
+	}
+
+	std::shared_ptr<pros::Motor_Group> motors =
+	    memory::make<pros::Motor_Group>(std::vector<int8_t>(ports));
+	if (motors == nullptr)
+		return -1;
+	motors->set_gearing(gearset);
+
+	mutex.take();
+	int id = mechanismCount;
+	mechanism_s_t& m = mechanisms[id];
+	m.motors = motors;
+	m.kP = kP;
+	m.kI = kI;
+	m.kD = kD;
+	m.kF = kF;
+	m.load = power::addLoad(motors);
+	mechanismCount++;
+	mutex.give();
+
+	return id;
+}
+
+void setLimits(int id, double min_position, double max_position) {
+	if (!valid(id))
+		return;
+	mutex.take();
+	mechanisms[id].min_position = min_position;
+	mechanisms[id].max_position = max_position;
+	mutex.give();
+}
+
+void setProfile(int id, double max_velocity, double max_accel) {
+	if (!valid(id))
+		return;
+	mutex.take();
+	mechanisms[id].max_velocity = max_velocity > 0 ? max_velocity : INFINITY;
+	mechanisms[id].max_accel = max_accel > 0 ? max_accel : INFINITY;
+	mutex.give();
+}
+
+void setTolerance(int id, double tolerance) {
+	if (!valid(id))
+		return;
+	mutex.take();
+	mechanisms[id].tolerance = tolerance;
+	mutex.give();
+}
+
+// switch a mechanism to a new mode and target. Profiles continue from the
+// present state so that changing targets mid-move is smooth. Must be called
+// with the mutex held.
+void setTarget(mechanism_s_t& m, MechanismMode_e_t mode, double target) {
+	if (m.mode != mode) {
+		double position = m.motors->size() ? (*m.motors)[0].get_position() : 0;
+		m.setpoint = position;
+		m.setpoint_v = 0;
+		m.integral = 0;
+		m.prev_error = 0;
+	}
+	m.mode = mode;
+	m.target = target;
+}
+
+void moveTo(int id, double position) {
+	if (!valid(id))
+		return;
+	mutex.take();
+	mechanism_s_t& m = mechanisms[id];
+	setTarget(m, MECHANISM_POSITION,
+	          fmin(fmax(position, m.min_position), m.max_position));
+	mutex.give();
+}
+
+void setVelocity(int id, double rpm) {
+	if (!valid(id))
+		return;
+	mutex.take();
+	setTarget(mechanisms[id], MECHANISM_VELOCITY, rpm);
+	mutex.give();
+}
+
+void setVoltage(int id, double percent) {
+	if (!valid(id))
+		return;
+	mutex.take();
+	setTarget(mechanisms[id], MECHANISM_VOLTAGE, percent);
+	mutex.give();
+}
+
+void stop(int id) {
+	if (!valid(id))
+		return;
+	mutex.take();
+	setTarget(mechanisms[id], MECHANISM_DISABLED, 0);
+	mutex.give();
+}
+
+bool atTarget(int id) {
+	if (!valid(id))
+		return false;
+	mutex.take();
+	mechanism_s_t& m = mechanisms[id];
+	bool at = true;
+	if (m.mode == MECHANISM_POSITION)
+		at = m.setpoint == m.target && fabs(m.target - m.measured) <= m.tolerance;
+	else if (m.mode == MECHANISM_VELOCITY)
+		at = fabs(m.target - m.measured) <= m.tolerance;
+	mutex.give();
+	return at;
+}
+
+bool waitUntilAtTarget(int id, uint32_t timeout) {
+	uint32_t start = pros::millis();
+	while (!atTarget(id)) {
+		if (pros::millis() - start >= timeout)
+			return false;
+		pros::delay(10);
+	}
+	return true;
+}
+
+double getPosition(int id) {
+	if (!valid(id))
+		return 0;
+	return (*mechanisms[id].motors)[0].get_position();
+}
+
+stats_s_t getStats(int id) {
+	if (!valid(id))
+		return {};
+	mutex.take();
+	stats_s_t stats = mechanisms[id].stats;
+	mutex.give();
+	return stats;
+}
+
+// advance a velocity towards a target within the acceleration limit
+double ramp(double v, double target, double max_accel, double dt) {
+	double step = max_accel * dt;
+	return v + fmin(fmax(target - v, -step), step);
+}
+
+// compute the output of a position move, advancing its trapezoidal profile
+double positionOutput(mechanism_s_t& m, double position, double dt) {
+	// the fastest speed that can still stop at the target
+	double remaining = m.target - m.setpoint;
+	double stopping = sqrt(2 * m.max_accel * 6 * fabs(remaining)) / 6;
+	double cruise = fmin(m.max_velocity, stopping);
+	m.setpoint_v = ramp(m.setpoint_v, remaining > 0 ? cruise : -cruise,
+	                    m.max_accel, dt);
+
+	// rpm to encoder degrees
+	double step = m.setpoint_v * 6 * dt;
+	if (fabs(step) >= fabs(remaining)) {
+		m.setpoint = m.target;
+		m.setpoint_v = 0;
+	} else {
+		m.setpoint += step;
+	}
+
+	double error = m.setpoint - position;
+	m.integral += error * dt;
+	double derivative = (error - m.prev_error) / dt;
+	m.prev_error = error;
+	return m.kF * m.setpoint_v + m.kP * error + m.kI * m.integral +
+	       m.kD * derivative;
+}
+
+// compute the output of a velocity hold
+double velocityOutput(mechanism_s_t& m, double velocity, double dt) {
+	m.setpoint_v = ramp(m.setpoint_v,
+	                    fmin(fmax(m.target, -m.max_velocity), m.max_velocity),
+	                    m.max_accel, dt);
+
+	double error = m.setpoint_v - velocity;
+	m.integral += error * dt;
+	double derivative = (error - m.prev_error) / dt;
+	m.prev_error = error;
+	return m.kF * m.setpoint_v + m.kP * error + m.kI * m.integral +
+	       m.kD * derivative;
+}
+
+void update(double dt) {
+	if (dt <= 0)
+		return;
+
+	mutex.take();
+	for (int i = 0; i < mechanismCount; i++) {
+		mechanism_s_t& m = mechanisms[i];
+		uint32_t start = pros::micros();
+
+		double position = (*m.motors)[0].get_position();
+		double velocity = (*m.motors)[0].get_actual_velocity();
+
+		double output = 0;
+		switch (m.mode) {
+		case MECHANISM_DISABLED:
+			break;
+		case MECHANISM_VOLTAGE:
+			output = m.target;
+			m.measured = position;
+			break;
+		case MECHANISM_POSITION:
+			output = positionOutput(m, position, dt);
+			m.measured = position;
+			break;
+		case MECHANISM_VELOCITY:
+			output = velocityOutput(m, velocity, dt);
+			m.measured = velocity;
+			break;
+		}
+
+		// never drive further past a limit
+		if ((position <= m.min_position && output < 0) ||
+		    (position >= m.max_position && output > 0))
+			output = 0;
+
+		// share the power budget and back off when hot
+		double derating = m.load >= 0 ? power::getDerating(m.load) : 1;
+		output = fmin(fmax(output, -100), 100) * power::getScale();
+		output = fmin(fmax(output, -100 * derating), 100 * derating);
+		m.motors->move_voltage(output * 120);
+
+		uint32_t time = pros::micros() - start;
+		m.stats.last = time;
+		m.stats.max = time > m.stats.max ? time : m.stats.max;
+		m.stats.mean += (time - m.stats.mean) / ++m.stats.ticks;
+	}
+	mutex.give();
+}
+
+} // namespace arms::mechanism
@@ -0,0 +1,40 @@
+#include "ARMS/memory.h"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace arms::memory {
+
+std::atomic<bool> locked(false);
+std::atomic<uint32_t> allocations(0);
+
+void lock() {
+	locked = true;
+}
+
+uint32_t getAllocations() {
+	return allocations;
+}
+
+} // namespace arms::memory
+
+#ifdef ARMS_STATIC
+// count allocations after initialization. Array and aligned forms call these
+// through the standard library's defaults.
+void* operator new(std::size_t size) {
+	if (arms::memory::locked)
+		arms::memory::allocations++;
+	void* p = malloc(size ? size : 1);
+	if (p == nullptr)
+		abort();
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	free(p);
+}
+#endif
@@ -2,18 +2,22 @@
 #include "api.h"
 #include "pros/rtos.hpp"
 
+#include <algorithm>
+#include <atomic>
+
 namespace arms::odom {
 
 config_data_s_t configData;
 
 // sensors
-std::shared_ptr<pros::Imu> imu = nullptr;
+std::shared_ptr<pros::Imu> imu = nullptr; // the first imu
 std::shared_ptr<pros::Rotation> rightRotation = nullptr;
 std::shared_ptr<pros::Rotation> leftRotation = nullptr;
 std::shared_ptr<pros::Rotation> middleRotation = nullptr;
 std::shared_ptr<pros::ADIEncoder> rightADIEncoder = nullptr;
 std::shared_ptr<pros::ADIEncoder> leftADIEncoder = nullptr;
 std::shared_ptr<pros::ADIEncoder> middleADIEncoder = nullptr;
+std::shared_ptr<pros::Gps> gps = nullptr;
 
 // output the odometry data to the terminal
 bool debug;
@@ -24,41 +28,225 @@ double left_right_distance;
 double middle_distance;
 double tpi;
 double middle_tpi;
+int substeps; // number of sub-steps to integrate each update with
 
 // odom position values
 Point position;
 double heading;
 
+// pose from the tracking wheels and imu alone, never corrected by absolute
+// measurements, used to find the motion between particle filter steps
+std::array<double, 3> raw_pose = {0, 0, 0};
+std::array<double, 3> mcl_raw_pose = {0, 0, 0};
+
+// velocity and acceleration, tracked from raw_pose by an alpha-beta-gamma
+// filter on each axis so that absolute corrections do not appear as motion.
+// With tracker::odom_gains the velocity lags a step change by about 50 ms
+// and the acceleration by about 150 ms.
+tracker::tracker_s_t motion[3];
+motion_s_t body_velocity = {0, 0, 0};
+motion_s_t body_acceleration = {0, 0, 0};
+motion_s_t field_velocity = {0, 0, 0};
+motion_s_t field_acceleration = {0, 0, 0};
+
+// timestamped poses, written by the odom task every update
+pose_s_t history[POSE_HISTORY];
+int history_head = 0; // index of the next pose to write
+int history_count = 0;
+
+// EKF process noise, variance added per inch travelled and per radian turned
+const double linear_noise = .01;
+const double wheel_angular_noise = .01; // heading from the tracking wheels
+const double imu_angular_noise = .0005; // heading from the imu
+
+// GPS measurement settings
+const uint32_t gps_period = 50;       // ms between gps updates
+const double gps_max_error = .3;      // largest reported error used (m)
+const double gps_heading_var = .0012; // heading variance (rad^2, ~2 degrees)
+double gps_offset[2] = {0, 0};        // sensor position on the robot (in)
+bool gps_seeded = false;              // the pose has been set from a fix
+
+// distance sensors used to relocalize against the field walls
+typedef struct distance_sensor_s {
+	std::shared_ptr<pros::Distance> sensor;
+	double x, y, theta; // mounting pose relative to the tracking center
+} distance_sensor_s_t;
+
+distance_sensor_s_t distanceSensors[MAX_DISTANCE_SENSORS];
+int distanceSensorCount = 0;
+bool relocalize_continuous = false;
+
+// relocalization settings
+const uint32_t relocalize_period = 50; // ms between continuous updates
+const int min_confidence = 30;         // distance sensor confidence (0-63)
+const int max_range = 2000;            // longest reading used (mm)
+const double max_incidence = .5;       // largest angle to the wall (rad)
+const double continuous_gate = 3;      // largest correction while moving (in)
+const double on_demand_gate = 12;      // largest correction on demand (in)
+
+// Monte Carlo localization settings
+int mcl_particles = 0;          // 0 disables the particle filter
+const uint32_t mcl_period = 20; // ms between updates
+const double mcl_noise_lin = .05;
+const double mcl_noise_ang = .05;
+const double mcl_spread = 2; // initial position spread (in)
+
+// guards the pose estimate, which is updated by both the odom task and
+// user calls such as reset() and relocalize()
+pros::Mutex mutex;
+
+// imus whose rotations are fused into the heading
+typedef struct imu_state_s {
+	std::shared_ptr<pros::Imu> sensor;
+	double prev;   // previous rotation (rad, counterclockwise)
+	bool valid;    // prev holds a valid reading
+	double bias;   // drift relative to the fused heading (rad per update)
+	double health; // 0-1, sensors below min_imu_health are not used
+} imu_state_s_t;
+
+imu_state_s_t imus[MAX_IMUS];
+int imuCount = 0;
+
+// startup
+bool ready = false;                   // sensors are valid and odom is running
+const uint32_t startup_timeout = 3000; // longest wait for sensors (ms)
+struct {
+	uint32_t start;          // odom::init() called
+	uint32_t devices;        // devices constructed
+	uint32_t imus[MAX_IMUS]; // each imu finished calibrating
+	uint32_t ready;          // odom started integrating
+} startup;
+
+// imu fusion settings
+const double max_imu_delta = .2;    // largest plausible change per update (rad)
+const double imu_agreement = .005;  // allowed disagreement per update (rad)
+const double min_imu_health = .2;   // health needed to be used
+const double imu_bias_gain = .001;  // rate of relative bias estimation
+
+// zero velocity updates. While the robot is stationary a small change in an
+// imu's rotation is drift, so its bias is estimated from that change and the
+// heading is held. The bias is then removed from every later update. A change
+// too large to be drift means the robot was moved.
+const double stationary_distance = .002; // largest wheel motion (in/update)
+const double stationary_rpm = 1;         // largest drive motor speed (rpm)
+const uint32_t stationary_time = 250;    // time still before updating (ms)
+const double zupt_bias_gain = .02;       // rate of bias estimation
+const double zupt_max_drift = .0005;     // largest drift (rad/update)
+bool stationary = false;
+uint32_t moving_time = 0; // last time the robot was seen moving
+
+// slip and collision detection. The drive motor encoders are compared to the
+// tracking wheels, using a scale learned while they agree, the wheel heading
+// change to the imu, and the wheel acceleration to the imu's. Hard horizontal
+// acceleration is a collision.
+const double slip_distance = .05;      // allowed disagreement (in/update)
+const double slip_ratio = .3;          // plus this fraction of the motion
+const double slip_angle = .01;         // allowed heading mismatch (rad/update)
+const double slip_accel = .3;          // allowed acceleration mismatch (g)
+const double collision_accel = 1.5;    // horizontal acceleration (g)
+const double gravity = 386.1;          // in/s^2 per g
+const double accel_smoothing = .1;     // imu filter gain, matching the lag of
+                                       // the wheel acceleration
+const double motor_scale_gain = .01;   // rate of motor scale estimation
+const double slip_noise = .25;         // variance per skipped inch
+const double collision_noise = .05;    // variance added on a collision (in^2)
+uint32_t event_time[2] = {0, 0};       // last time of each event, 0 if never
+double motor_scale = 0;                // inches per motor encoder unit
+double prev_motor_pos = NAN;
+tracker::tracker_s_t wheel_motion; // forward travel of the wheels
+double wheel_travel = 0;           // (in)
+double imu_accel = 0;              // smoothed horizontal acceleration (g)
+uint32_t accel_time = 0;           // time of the last comparison (us)
+
+// sensor health. Tracking wheels that return errors, jump further than is
+// possible, or stop while the other wheel moves without the robot turning
+// about them are marked failed. The left and right wheels then fall back to
+// the drive motor encoders, and a failed middle wheel reads no motion.
+const double max_wheel_step = 2; // largest plausible motion (in/update)
+const int frozen_updates = 25;   // updates stopped before failing (250 ms)
+const double frozen_motion = .05; // motion of the other wheel (in/update)
+int failed = 0;                   // mask of failed sensors
+int frozen[2] = {0, 0};           // updates the left and right wheel stopped
+bool motorFailover = false;       // left and right read from the motors
+
+// failure message on the screen. The odom task only stores the text, and an
+// lvgl task shows it so that the screen is changed from the display thread.
+lv_obj_t* warning = nullptr;
+char warning_text[128];
+std::atomic<bool> warning_pending(false);
+
+// motor in each drive group the odom task reads, -1 if none is reporting
+int motor_source[2] = {0, 0};
+
+// return the position of the first motor in a group that is reporting, or
+// NAN if none is. If source is given it holds the motor read last time, and
+// a change of motor also returns NAN, since the motors' positions differ.
+double groupPosition(std::shared_ptr<pros::Motor_Group> motors,
+                     int* source = nullptr) {
+	for (int i = 0; i < motors->size(); i++) {
+		double position = (*motors)[i].get_position();
+		if (position == PROS_ERR_F)
+			continue;
+		if (source == nullptr)
+			return position;
+		bool changed = i != *source;
+		*source = i;
+		return changed ? NAN : position;
+	}
+	if (source)
+		*source = -1;
+	return NAN;
+}
+
+// return the position of a drive motor group converted to tracking wheel
+// ticks, using the scale learned while the tracking wheels worked or, if
+// none was learned, the configured speed of the drive
+double motorTicks(std::shared_ptr<pros::Motor_Group> motors,
+                  int* source = nullptr) {
+	double scale = motor_scale;
+	if (scale == 0)
+		scale = chassis::max_velocity * 60 / chassis::maxRPM / 360;
+	return groupPosition(motors, source) * scale * tpi;
+}
+
 // previous values
 double prev_left_pos = 0;
 double prev_right_pos = 0;
 double prev_middle_pos = 0;
-double prev_heading = 0;
 
 double getLeftEncoder() {
-	if (configData.encoderType == ENCODER_ADI && leftADIEncoder != nullptr) {
+	if (motorFailover && chassis::leftMotors) {
+		return motorTicks(chassis::leftMotors);
+	} else if (configData.encoderType == ENCODER_ADI &&
+	           leftADIEncoder != nullptr) {
 		return leftADIEncoder->get_value();
 	} else if (leftRotation != nullptr) {
 		return leftRotation->get_position();
 	} else if (chassis::leftMotors) {
-		return chassis::leftMotors->get_positions()[0];
+		return groupPosition(chassis::leftMotors);
 	}
 	return 0;
 }
 
 double getRightEncoder() {
-	if (configData.encoderType == ENCODER_ADI && rightADIEncoder != nullptr) {
+	if (motorFailover && chassis::rightMotors) {
+		return motorTicks(chassis::rightMotors);
+	} else if (configData.encoderType == ENCODER_ADI &&
+	           rightADIEncoder != nullptr) {
 		return rightADIEncoder->get_value();
 	} else if (rightRotation != nullptr) {
 		return rightRotation->get_position();
 	} else if (chassis::rightMotors) {
-		return chassis::rightMotors->get_positions()[0];
+		return groupPosition(chassis::rightMotors);
 	}
 	return 0;
 }
 
 double getMiddleEncoder() {
-	if (configData.encoderType == ENCODER_ADI && middleADIEncoder != nullptr) {
+	if (failed & SENSOR_MIDDLE) {
+		return 0;
+	} else if (configData.encoderType == ENCODER_ADI &&
+	           middleADIEncoder != nullptr) {
 		return middleADIEncoder->get_value();
 	} else if (middleRotation != nullptr) {
 		return middleRotation->get_position();
@@ -66,60 +254,781 @@ double getMiddleEncoder() {
 	return 0;
 }
 
-int odomTask() {
+// move the robot along a constant curvature arc, given the distance travelled
+// by the right and middle tracking wheels and the change in heading. The
+// motion is applied as the prediction step of the pose EKF.
+void integrateArc(double delta_right, double delta_middle, double delta_angle,
+                  double angular_noise) {
+	// local displacement along the chord of the arc
+	std::array<double, 2> local =
+	    arc::chord(delta_right, delta_middle, delta_angle, left_right_distance,
+	               middle_distance);
 
-	position.x = 0;
-	position.y = 0;
-	heading = 0;
+	double distance = fabs(local[0]) + fabs(local[1]);
+	ekf::predict(local[0], local[1], delta_angle, linear_noise * distance,
+	             angular_noise * fabs(delta_angle));
+
+	arc::apply(raw_pose, local[0], local[1], delta_angle);
+}
+
+// correct the pose with the GPS sensor. The GPS reports the position of the
+// sensor in meters and a compass heading, which are converted to the position
+// of the tracking center in inches and a counterclockwise heading from the x
+// axis. The first fix sets the pose, since the odometry starts at the origin
+// rather than in the GPS frame and would reject every fix as an outlier. Must
+// be called with the odom mutex held.
+void updateGps() {
+	double error = gps->get_error();
+	if (!(error > 0 && error < gps_max_error))
+		return; // no fix, or too inaccurate to be useful
+
+	pros::c::gps_status_s_t status = gps->get_status();
+	double theta = (90 - gps->get_heading()) * M_PI / 180.0;
+	double x = status.x * 39.37 - cos(theta) * gps_offset[0] +
+	           sin(theta) * gps_offset[1];
+	double y = status.y * 39.37 - sin(theta) * gps_offset[0] -
+	           cos(theta) * gps_offset[1];
+	double pos_var = (error * 39.37) * (error * 39.37);
+
+	if (!gps_seeded) {
+		// keep the heading continuous with the current estimate
+		double heading = ekf::getState()[2];
+		theta = heading + remainder(theta - heading, 2 * M_PI);
+		ekf::reset(x, y, theta, pos_var, gps_heading_var);
+		history_count = 0;
+		if (mcl_particles)
+			mcl::init(mcl_particles, x, y, theta, mcl_spread, .02);
+		gps_seeded = true;
+		return;
+	}
+
+	ekf::updatePose(x, y, theta, pos_var, gps_heading_var);
+}
+
+// return a distance sensor reading in inches, or -1 if it is low confidence
+// or out of range
+double readDistance(distance_sensor_s_t& s) {
+	int32_t mm = s.sensor->get();
+	if (mm == PROS_ERR || mm <= 0 || mm > max_range)
+		return -1;
+	if (s.sensor->get_confidence() < min_confidence)
+		return -1;
+	return mm / 25.4;
+}
+
+// sensor accuracy is about 15 mm up to 200 mm and 5% beyond
+double distanceSigma(double measured) {
+	return fmax(.6, .05 * measured);
+}
+
+// correct the pose with a distance sensor reading of a wall, returning true
+// if the reading was accepted. Readings that are low confidence, out of
+// range, at a glancing angle to the wall, or further than gate from the
+// expected distance are rejected. Must be called with the odom mutex held.
+bool relocalizeSensor(distance_sensor_s_t& s, double gate) {
+	double measured = readDistance(s);
+	if (measured < 0)
+		return false;
+
+	// pose of the sensor on the field
+	std::array<double, 3> pose = ekf::getState();
+	double c = cos(pose[2]);
+	double sn = sin(pose[2]);
+	double sx = pose[0] + c * s.x - sn * s.y;
+	double sy = pose[1] + sn * s.x + c * s.y;
+	double st = pose[2] + s.theta;
+
+	int i;
+	double predicted = field::raycast(sx, sy, st, &i);
+	if (predicted < 0)
+		return false;
+
+	// unit normal of the wall, pointing towards the sensor
+	double len = hypot(field::segments.dx[i], field::segments.dy[i]);
+	double nx = -field::segments.dy[i] / len;
+	double ny = field::segments.dx[i] / len;
+	double cos_incidence = -(nx * cos(st) + ny * sin(st));
+	if (cos_incidence < 0) {
+		nx = -nx, ny = -ny;
+		cos_incidence = -cos_incidence;
+	}
+	if (cos_incidence < cos(max_incidence))
+		return false;
+
+	// the reading measures the distance of the robot from the wall along its
+	// normal, which corrects the position in that direction only
+	double innovation = (measured - predicted) * cos_incidence;
+	if (fabs(innovation) > gate)
+		return false;
+
+	double sigma = distanceSigma(measured) * cos_incidence;
+	return ekf::updateLinear(nx, ny, 0, innovation, sigma * sigma);
+}
+
+// step the particle filter with the motion since the last step and the
+// distance sensor readings, then correct the EKF position with the particle
+// estimate. Must be called with the odom mutex held.
+void updateMcl() {
+	// odometry motion since the last step, in the robot frame at the middle of
+	// the step
+	std::array<double, 3>& prev = mcl_raw_pose;
+	double dx = raw_pose[0] - prev[0];
+	double dy = raw_pose[1] - prev[1];
+	double delta_theta = raw_pose[2] - prev[2];
+	double p = prev[2] + delta_theta / 2;
+	double local_x = cos(p) * dx + sin(p) * dy;
+	double local_y = -sin(p) * dx + cos(p) * dy;
+	mcl::predict(local_x, local_y, delta_theta, mcl_noise_lin, mcl_noise_ang);
+
+	for (int i = 0; i < distanceSensorCount; i++) {
+		distance_sensor_s_t& s = distanceSensors[i];
+		double measured = readDistance(s);
+		if (measured >= 0)
+			mcl::update(s.x, s.y, s.theta, measured, distanceSigma(measured));
+	}
+	mcl::resample();
+
+	std::array<double, 3> pose = ekf::getState();
+	std::array<double, 3> estimate = mcl::estimate();
+	double var = mcl::variance() + .1;
+	ekf::updateLinear(1, 0, 0, estimate[0] - pose[0], var);
+	// the x update moves y through their covariance
+	pose = ekf::getState();
+	ekf::updateLinear(0, 1, 0, estimate[1] - pose[1], var);
+
+	prev = raw_pose;
+}
+
+// add the current pose to the history. Must be called with the odom mutex
+// held.
+void recordPose(uint32_t time) {
+	history[history_head] = {time, position.x, position.y, heading};
+	history_head = (history_head + 1) % POSE_HISTORY;
+	if (history_count < POSE_HISTORY)
+		history_count++;
+}
+
+// return the i-th oldest pose in the history
+pose_s_t& historyAt(int i) {
+	return history[(history_head - history_count + i + POSE_HISTORY) %
+	               POSE_HISTORY];
+}
+
+// return the index of the newest pose recorded at or before time, or -1 if
+// every pose is newer
+int historySearch(uint32_t time) {
+	int lo = 0;
+	int hi = history_count - 1;
+	int found = -1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (historyAt(mid).time <= time) {
+			found = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return found;
+}
+
+// return the rotation of the first imu in radians counterclockwise, or NAN
+double imuRotation() {
+	double rotation = imu ? imu->get_rotation() : PROS_ERR_F;
+	if (rotation == PROS_ERR_F || !std::isfinite(rotation))
+		return NAN;
+	return -rotation * M_PI / 180.0;
+}
+
+// report a sensor failure in the terminal and on the screen. A failure
+// reported before the last one was shown only goes to the terminal.
+void reportFailure(const char* sensor, const char* fallback) {
+	printf("ARMS ERROR: %s failed, using %s\n", sensor, fallback);
+
+	if (warning_pending)
+		return;
+	snprintf(warning_text, sizeof(warning_text), "%s failed, using %s", sensor,
+	         fallback);
+	warning_pending = true;
+}
+
+// lvgl task showing the latest failure
+void showWarning(void*) {
+	if (!warning_pending)
+		return;
+	if (warning == nullptr) {
+		warning = lv_label_create(lv_layer_top(), NULL);
+		lv_obj_align(warning, NULL, LV_ALIGN_IN_BOTTOM_MID, 0, -10);
+	}
+	lv_label_set_text(warning, warning_text);
+	warning_pending = false;
+}
+
+// return true if every drive motor is turning slower than stationary_rpm
+bool motorsStopped() {
+	for (auto group : {chassis::leftMotors, chassis::rightMotors}) {
+		if (!group)
+			continue;
+		for (int i = 0; i < group->size(); i++) {
+			double v = (*group)[i].get_actual_velocity();
+			if (v == PROS_ERR_F || fabs(v) > stationary_rpm)
+				return false;
+		}
+	}
+	return true;
+}
+
+// decide whether the robot has been still for long enough to trust that the
+// imus should read no change in rotation
+bool updateStationary(double delta_left, double delta_right,
+                      double delta_middle, bool collision) {
+	uint32_t now = pros::millis();
+	bool still = !collision && fabs(delta_left) < stationary_distance &&
+	             fabs(delta_right) < stationary_distance &&
+	             fabs(delta_middle) < stationary_distance && motorsStopped();
+	if (!still)
+		moving_time = now;
+	return now - moving_time >= stationary_time;
+}
+
+// read every imu and fuse their changes in rotation into a single change in
+// heading, returning false if no imu is healthy. Each change is checked for
+// errors and spikes, and compared to the median of the others. A pair is
+// compared to each other, and the wheels pick which to believe only when they
+// disagree. Rejected sensors lose health and are not
+// used until they recover. Because changes are fused rather than absolute
+// rotations, dropping a sensor does not move the heading.
+bool fuseImus(double wheel_delta, double* delta) {
+	double deltas[MAX_IMUS];
+	bool ok[MAX_IMUS];
+	int okCount = 0;
+
+	for (int i = 0; i < imuCount; i++) {
+		imu_state_s_t& s = imus[i];
+		double rotation = s.sensor->get_rotation();
+		ok[i] = false;
+
+		if (rotation == PROS_ERR_F || !std::isfinite(rotation)) {
+			s.valid = false; // disconnected or calibrating
+			continue;
+		}
+
+		double r = -rotation * M_PI / 180.0;
+		deltas[i] = r - s.prev - s.bias;
+		ok[i] = s.valid && fabs(deltas[i]) < max_imu_delta;
+		s.prev = r;
+		s.valid = true;
+		okCount += ok[i];
+	}
+
+	// reference change to compare each sensor against
+	double reference = NAN;
+	if (okCount >= 3) {
+		double sorted[MAX_IMUS];
+		int n = 0;
+		for (int i = 0; i < imuCount; i++)
+			if (ok[i])
+				sorted[n++] = deltas[i];
+		std::sort(sorted, sorted + n);
+		reference = n % 2 ? sorted[n / 2]
+		                  : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+	} else if (okCount == 2) {
+		int a = -1, b = -1;
+		for (int i = 0; i < imuCount; i++)
+			if (ok[i])
+				(a < 0 ? a : b) = i;
+
+		// allow for one of the pair repeating or doubling a 10 ms sample
+		double window = imu_agreement + fmax(fabs(deltas[a]), fabs(deltas[b]));
+		if (fabs(deltas[a] - deltas[b]) > window && std::isfinite(wheel_delta)) {
+			if (fabs(deltas[a] - wheel_delta) > fabs(deltas[b] - wheel_delta))
+				ok[a] = false;
+			else
+				ok[b] = false;
+		}
+	}
+
+	double sum = 0;
+	double weight = 0;
+	for (int i = 0; i < imuCount; i++) {
+		imu_state_s_t& s = imus[i];
+		if (ok[i] && std::isfinite(reference) &&
+		    fabs(deltas[i] - reference) > imu_agreement + .1 * fabs(reference))
+			ok[i] = false;
+
+		// a reading that stops while the wheels turn is frozen
+		if (ok[i] && deltas[i] + s.bias == 0 && std::isfinite(wheel_delta) &&
+		    fabs(wheel_delta) > .005)
+			ok[i] = false;
+
+		bool healthy = s.health >= min_imu_health;
+		if (ok[i])
+			s.health += (1 - s.health) * .02;
+		else
+			s.health *= .8;
+		if (healthy && s.health < min_imu_health) {
+			static char name[16];
+			snprintf(name, sizeof(name), "imu %d", i + 1);
+			reportFailure(name, "the remaining heading sensors");
+		}
+
+		if (ok[i] && s.health >= min_imu_health) {
+			sum += deltas[i] * s.health;
+			weight += s.health;
+		}
+	}
+
+	if (weight == 0) {
+		failed |= SENSOR_IMU;
+		return false;
+	}
+	failed &= ~SENSOR_IMU;
+	*delta = sum / weight;
+
+	// while stationary, a small change is drift. A larger one is the robot
+	// being pushed, which is integrated and ends the stationary period.
+	if (stationary && fabs(*delta) < zupt_max_drift) {
+		for (int i = 0; i < imuCount; i++)
+			if (ok[i])
+				imus[i].bias += zupt_bias_gain * deltas[i];
+		*delta = 0;
+		return true;
+	}
+	if (stationary) {
+		stationary = false;
+		moving_time = pros::millis();
+	}
+
+	// estimate each sensor's drift relative to the fused change
+	if (imuCount > 1)
+		for (int i = 0; i < imuCount; i++)
+			if (ok[i])
+				imus[i].bias += imu_bias_gain * (deltas[i] - *delta);
+
+	return true;
+}
+
+// rotate a vector by an angle
+motion_s_t rotate(motion_s_t v, double angle) {
+	return {v.x * cos(angle) - v.y * sin(angle),
+	        v.x * sin(angle) + v.y * cos(angle), v.theta};
+}
+
+// track the velocity and acceleration over an update of dt seconds, and
+// publish them in the body and field frames
+void updateMotion(double dt) {
+	for (int i = 0; i < 3; i++)
+		tracker::update(motion[i], raw_pose[i], dt, tracker::odom_gains);
+
+	// the raw frame differs from the corrected one by a rotation, so go
+	// through the body frame to reach the corrected field frame
+	body_velocity = rotate(
+	    {motion[0].velocity, motion[1].velocity, motion[2].velocity},
+	    -raw_pose[2]);
+	body_acceleration = rotate(
+	    {motion[0].acceleration, motion[1].acceleration, motion[2].acceleration},
+	    -raw_pose[2]);
+	field_velocity = rotate(body_velocity, ekf::getState()[2]);
+	field_acceleration = rotate(body_acceleration, ekf::getState()[2]);
+}
+
+// odometry backends. The sensors the odom task reads are fixed by the
+// configuration, so the task is instantiated for them once in init() and
+// reads and checks them without testing the configuration on every update.
+// Failover to the motor encoders is still checked, since it happens at
+// runtime.
+typedef enum Backend {
+	BACKEND_ADI,      // ADI tracking wheel encoders
+	BACKEND_ROTATION, // rotation sensor tracking wheels
+	BACKEND_MOTOR,    // drive motor encoders, left and right only
+	BACKEND_NONE      // no sensor, middle only
+} Backend_e_t;
+
+// return true if the left and right encoders are tracking wheels rather than
+// the drive motors
+template <Backend_e_t B> bool hasTrackingWheels() {
+	return B != BACKEND_MOTOR && !motorFailover;
+}
+
+// return the average drive motor encoder position, or NAN if unavailable
+double getMotorPosition() {
+	if (!chassis::leftMotors || !chassis::rightMotors)
+		return NAN;
+	double left = (*chassis::leftMotors)[0].get_position();
+	double right = (*chassis::rightMotors)[0].get_position();
+	if (left == PROS_ERR_F || right == PROS_ERR_F)
+		return NAN;
+	return (left + right) / 2;
+}
+
+// return the first imu's acceleration, with PROS_ERR_F components if there is
+// no imu or it cannot be read
+template <bool Imu> pros::c::imu_accel_s_t readAccel() {
+	if constexpr (Imu)
+		return imu->get_accel();
+	else
+		return {PROS_ERR_F, PROS_ERR_F, PROS_ERR_F};
+}
+
+// return true if an acceleration is hard enough to be a collision
+bool collided(pros::c::imu_accel_s_t accel) {
+	return accel.x != PROS_ERR_F &&
+	       accel.x * accel.x + accel.y * accel.y >
+	           collision_accel * collision_accel;
+}
+
+// check one update for wheel slip and collisions, returning a mask of the
+// events detected
+template <Backend_e_t B>
+int detectEvents(double delta_left, double delta_right, double wheel_delta,
+                 double delta_angle, bool imu_heading,
+                 pros::c::imu_accel_s_t accel) {
+	int events = 0;
+
+	// drive wheels spinning or dragging relative to the tracking wheels
+	double motor_pos = getMotorPosition();
+	if (hasTrackingWheels<B>() && std::isfinite(motor_pos) &&
+	    std::isfinite(prev_motor_pos)) {
+		double motor_delta = motor_pos - prev_motor_pos;
+		double tracked = (delta_left + delta_right) / 2;
+		if (motor_scale != 0 &&
+		    fabs(motor_delta * motor_scale - tracked) >
+		        slip_distance + slip_ratio * fabs(tracked))
+			events |= EVENT_SLIP;
+		else if (fabs(motor_delta) > 1e-6 && fabs(tracked) > .05)
+			motor_scale += (motor_scale == 0 ? 1 : motor_scale_gain) *
+			               (tracked / motor_delta - motor_scale);
+	}
+	prev_motor_pos = motor_pos;
+
+	// one side slipping turns the wheels without turning the robot
+	if (imu_heading && std::isfinite(wheel_delta) &&
+	    fabs(wheel_delta - delta_angle) >
+	        slip_angle + slip_ratio * fabs(delta_angle))
+		events |= EVENT_SLIP;
+
+	// drive wheels accelerating differently from the robot, which catches both
+	// sides spinning on motor encoders. The imu's mounting is not configured,
+	// so horizontal magnitudes are compared, including the wheels' turning
+	// acceleration. Tracking wheels were checked against the motors above.
+	if (accel.x != PROS_ERR_F) {
+		uint32_t now = pros::micros();
+		double dt = (now - accel_time) / 1e6;
+		accel_time = now;
+		wheel_travel += (delta_left + delta_right) / 2;
+		tracker::update(wheel_motion, wheel_travel, dt, tracker::odom_gains);
+		double rate = dt > 0 ? delta_angle / dt : 0;
+		double wheel_accel = hypot(wheel_motion.acceleration,
+		                           wheel_motion.velocity * rate) /
+		                     gravity;
+		imu_accel += accel_smoothing * (hypot(accel.x, accel.y) - imu_accel);
+		if (!hasTrackingWheels<B>() && !collided(accel) &&
+		    fabs(wheel_accel - imu_accel) > slip_accel + slip_ratio * imu_accel)
+			events |= EVENT_SLIP;
+	}
+
+	// impacts
+	if (collided(accel))
+		events |= EVENT_COLLISION;
+
+	uint32_t now = pros::millis();
+	if (events & EVENT_SLIP)
+		event_time[0] = now;
+	if (events & EVENT_COLLISION)
+		event_time[1] = now;
+	return events;
+}
+
+// check one tracking wheel, returning true if it has failed
+bool wheelFailed(int index, double pos, double prev, double wheel_tpi,
+                 double other_delta, double expected_other) {
+	if (pos == PROS_ERR)
+		return true; // unplugged
+	if (fabs(pos - prev) / wheel_tpi > max_wheel_step)
+		return true;
+	if (index > 1)
+		return false; // the middle wheel has nothing to compare against
+
+	// stopped while the other wheel moves, unless the robot is pivoting
+	// about this wheel. Without an independent heading a pivot cannot be told
+	// apart from a frozen wheel, so nothing is counted.
+	bool pivoting = !std::isfinite(expected_other) ||
+	                fabs(other_delta - expected_other) <
+	                    .3 * fabs(other_delta) + frozen_motion;
+	if (pos == prev && fabs(other_delta) > frozen_motion && !pivoting)
+		frozen[index]++;
+	else
+		frozen[index] = 0;
+	return frozen[index] >= frozen_updates;
+}
+
+// check the tracking wheels before their readings are used, switching to the
+// fallbacks if any have failed. turned is the last change in heading fused
+// from the imus, or NAN if there was none. Returns true if a source changed,
+// in which case the positions must be read again.
+template <Backend_e_t B, Backend_e_t M>
+bool checkSensors(double left_pos, double right_pos, double middle_pos,
+                  double turned) {
+	// rotation about the left wheel moves the right wheel by the track width
+	// times the change in heading, and the reverse for the right wheel
+	bool changed = false;
+	if (hasTrackingWheels<B>() && !(failed & (SENSOR_LEFT | SENSOR_RIGHT))) {
+		double dl = (left_pos - prev_left_pos) / tpi;
+		double dr = (right_pos - prev_right_pos) / tpi;
+		bool left = wheelFailed(0, left_pos, prev_left_pos, tpi, dr,
+		                        track_width * turned);
+		bool right = wheelFailed(1, right_pos, prev_right_pos, tpi, dl,
+		                         -track_width * turned);
+		const char* name = left ? "left tracking wheel" : "right tracking wheel";
+		if ((left || right) && chassis::isHolonomic) {
+			// holonomic drive wheels turn while strafing, so they cannot stand
+			// in for the tracking wheels. The failed wheel is no longer read.
+			failed |= (left ? SENSOR_LEFT : 0) | (right ? SENSOR_RIGHT : 0);
+			changed = true;
+			reportFailure(name, "the other wheel and the imu heading");
+		} else if (left || right) {
+			failed |= (left ? SENSOR_LEFT : 0) | (right ? SENSOR_RIGHT : 0);
+			motorFailover = true;
+			changed = true;
+			reportFailure(name, "motor encoders");
+		}
+	}
+
+	if (M != BACKEND_NONE && !(failed & SENSOR_MIDDLE) &&
+	    wheelFailed(2, middle_pos, prev_middle_pos, middle_tpi, 0, NAN)) {
+		failed |= SENSOR_MIDDLE;
+		changed = true;
+		reportFailure("middle tracking wheel", "no sideways motion");
+	}
+
+	return changed;
+}
+
+// wait for the sensors to finish starting up, recording how long each took,
+// then take their current readings as the starting point. Imus that do not
+// calibrate in time are left out of the heading.
+void waitForSensors() {
+	uint32_t deadline = startup.start + startup_timeout;
+
+	for (int i = 0; i < imuCount; i++) {
+		// calibration may not be reported as started right away
+		bool seen = false;
+		while (pros::millis() < deadline) {
+			bool calibrating = imus[i].sensor->is_calibrating();
+			seen = seen || calibrating;
+			if (!calibrating && (seen || pros::millis() - startup.start > 200))
+				break;
+			pros::delay(10);
+		}
+		startup.imus[i] = pros::millis();
+		if (imus[i].sensor->is_calibrating()) {
+			printf("ARMS ERROR: IMU %d did not finish calibrating\n", i + 1);
+			imus[i].health = 0;
+		}
+	}
+
+	// rotation sensors report an error until they are ready
+	auto rotationReady = [](std::shared_ptr<pros::Rotation> r) {
+		return r == nullptr || r->get_position() != PROS_ERR;
+	};
+	while (pros::millis() < deadline &&
+	       !(rotationReady(leftRotation) && rotationReady(rightRotation) &&
+	         rotationReady(middleRotation)))
+		pros::delay(10);
+
+	prev_left_pos = getLeftEncoder();
+	prev_right_pos = getRightEncoder();
+	prev_middle_pos = configData.middleEncoderPort ? getMiddleEncoder() : 0;
+	prev_motor_pos = getMotorPosition();
+	for (int i = 0; i < imuCount; i++) {
+		double rotation = imus[i].sensor->get_rotation();
+		imus[i].valid = rotation != PROS_ERR_F && std::isfinite(rotation);
+		imus[i].prev = imus[i].valid ? -rotation * M_PI / 180.0 : 0;
+	}
+
+	startup.ready = pros::millis();
+	ready = true;
+	printStartupReport();
+}
+
+template <Backend_e_t B> double readLeft() {
+	if (B != BACKEND_MOTOR && motorFailover)
+		return motorTicks(chassis::leftMotors, &motor_source[0]);
+	if constexpr (B == BACKEND_ADI)
+		return leftADIEncoder->get_value();
+	else if constexpr (B == BACKEND_ROTATION)
+		return leftRotation->get_position();
+	else
+		return groupPosition(chassis::leftMotors, &motor_source[0]);
+}
+
+template <Backend_e_t B> double readRight() {
+	if (B != BACKEND_MOTOR && motorFailover)
+		return motorTicks(chassis::rightMotors, &motor_source[1]);
+	if constexpr (B == BACKEND_ADI)
+		return rightADIEncoder->get_value();
+	else if constexpr (B == BACKEND_ROTATION)
+		return rightRotation->get_position();
+	else
+		return groupPosition(chassis::rightMotors, &motor_source[1]);
+}
+
+template <Backend_e_t M> double readMiddle() {
+	if constexpr (M == BACKEND_NONE)
+		return 0;
+	else if (failed & SENSOR_MIDDLE)
+		return 0;
+	else if constexpr (M == BACKEND_ADI)
+		return middleADIEncoder->get_value();
+	else
+		return middleRotation->get_position();
+}
+
+template <Backend_e_t B, Backend_e_t M, bool Imu> int odomTask() {
+	waitForSensors();
+
+	// changes from the previous update, for sub-stepping
+	double prev_delta_right = 0;
+	double prev_delta_middle = 0;
+	double prev_delta_angle = 0;
+
+	uint32_t last_gps = pros::millis();
+	uint32_t last_relocalize = pros::millis();
+	uint32_t last_mcl = pros::millis();
+	uint32_t last_motion = pros::micros();
+	double imu_delta = NAN; // heading change fused from the imus last update
 
 	while (true) {
 		// get positions of each encoder
-		double left_pos = getLeftEncoder();
-		double right_pos = getRightEncoder();
-		double middle_pos = configData.middleEncoderPort ? getMiddleEncoder() : 0;
+		double left_pos = readLeft<B>();
+		double right_pos = readRight<B>();
+		double middle_pos = readMiddle<M>();
+
+		// restart from the fallbacks if a wheel failed, dropping this update's
+		// motion so that the pose does not jump
+		if (checkSensors<B, M>(left_pos, right_pos, middle_pos, imu_delta)) {
+			left_pos = prev_left_pos = readLeft<B>();
+			right_pos = prev_right_pos = readRight<B>();
+			middle_pos = prev_middle_pos = readMiddle<M>();
+		}
+
+		// skip the step while no motor in a drive group is reporting, and
+		// restart from the next readings, which may come from another motor
+		if (!std::isfinite(left_pos) || !std::isfinite(right_pos)) {
+			prev_left_pos = prev_right_pos = NAN;
+			pros::delay(10);
+			continue;
+		}
+		if (!std::isfinite(prev_left_pos) || !std::isfinite(prev_right_pos)) {
+			prev_left_pos = left_pos;
+			prev_right_pos = right_pos;
+		}
 
 		// calculate change in each encoder
 		double delta_left = (left_pos - prev_left_pos) / tpi;
 		double delta_right = (right_pos - prev_right_pos) / tpi;
-		double delta_middle = configData.middleEncoderPort
-		                          ? (middle_pos - prev_middle_pos) / middle_tpi
-		                          : 0;
+		double delta_middle =
+		    M != BACKEND_NONE ? (middle_pos - prev_middle_pos) / middle_tpi : 0;
 
-		// calculate new heading
+		// a failed wheel on a holonomic drive has no fallback, so its motion is
+		// derived from the other wheel once the imu heading is known
+		bool derived =
+		    chassis::isHolonomic && (failed & (SENSOR_LEFT | SENSOR_RIGHT));
+		if (derived && (failed & SENSOR_LEFT))
+			delta_left = 0;
+		if (derived && (failed & SENSOR_RIGHT))
+			delta_right = 0;
+
+		// calculate change in heading, integrating the imu rates when available
+		double wheel_delta = track_width && !derived
+		                         ? (delta_right - delta_left) / track_width
+		                         : NAN;
+		// an impact can turn the robot without moving the wheels, so it ends a
+		// stationary period
+		pros::c::imu_accel_s_t accel = readAccel<Imu>();
+		stationary = updateStationary(delta_left, delta_right, delta_middle,
+		                              collided(accel));
 		double delta_angle;
-		if (imu) {
-			heading = -imu->get_rotation() * M_PI / 180.0;
-			delta_angle = heading - prev_heading;
+		double angular_noise;
+		bool imu_heading = Imu && fuseImus(wheel_delta, &delta_angle);
+		imu_delta = imu_heading ? delta_angle : NAN;
+		if (derived && imu_heading && !(failed & SENSOR_RIGHT))
+			delta_left = delta_right - track_width * delta_angle;
+		else if (derived && imu_heading && !(failed & SENSOR_LEFT))
+			delta_right = delta_left + track_width * delta_angle;
+		if (imu_heading) {
+			angular_noise = imu_angular_noise;
 		} else {
-			delta_angle = (delta_right - delta_left) / track_width;
+			delta_angle = std::isfinite(wheel_delta) ? wheel_delta : 0;
+			angular_noise = wheel_angular_noise;
+		}
 
-			heading += delta_angle;
+		// without tracking wheels a slipping drive wheel's motion is wrong, so
+		// the step's translation is skipped and the uncertainty grown instead
+		int events = detectEvents<B>(delta_left, delta_right, wheel_delta,
+		                             delta_angle, imu_heading, accel);
+		double skipped = 0;
+		if ((events & EVENT_SLIP) && !hasTrackingWheels<B>()) {
+			skipped = fabs(delta_right) + fabs(delta_middle);
+			delta_right = left_right_distance * delta_angle;
+			delta_middle = -middle_distance * delta_angle;
 		}
 
 		// store previous positions
 		prev_left_pos = left_pos;
 		prev_right_pos = right_pos;
 		prev_middle_pos = middle_pos;
-		prev_heading = heading;
 
-		// calculate local displacement
-		double local_x;
-		double local_y;
+		mutex.take();
 
-		if (delta_angle) {
-			double i = sin(delta_angle / 2.0) * 2.0;
-			local_x = (delta_right / delta_angle - left_right_distance) * i;
-			local_y = (delta_middle / delta_angle + middle_distance) * i;
-		} else {
-			local_x = delta_right;
-			local_y = delta_middle;
+		// integrate the motion over the step as a series of arcs
+		for (int i = 0; i < substeps; i++) {
+			double r = arc::substepWeight(i, substeps, delta_right, prev_delta_right);
+			double m =
+			    arc::substepWeight(i, substeps, delta_middle, prev_delta_middle);
+			double a = arc::substepWeight(i, substeps, delta_angle, prev_delta_angle);
+			integrateArc(delta_right * r, delta_middle * m, delta_angle * a,
+			             angular_noise);
+		}
+
+		prev_delta_right = delta_right;
+		prev_delta_middle = delta_middle;
+		prev_delta_angle = delta_angle;
+
+		if (skipped > 0 || (events & EVENT_COLLISION))
+			ekf::predict(0, 0, 0,
+			             slip_noise * skipped +
+			                 (events & EVENT_COLLISION ? collision_noise : 0),
+			             0);
+
+		// absolute corrections
+		if (gps && pros::millis() - last_gps >= gps_period) {
+			updateGps();
+			last_gps = pros::millis();
+		}
+		if (relocalize_continuous &&
+		    pros::millis() - last_relocalize >= relocalize_period) {
+			for (int i = 0; i < distanceSensorCount; i++)
+				relocalizeSensor(distanceSensors[i], continuous_gate);
+			last_relocalize = pros::millis();
+		}
+		if (mcl_particles && pros::millis() - last_mcl >= mcl_period) {
+			updateMcl();
+			last_mcl = pros::millis();
 		}
 
-		double p = heading - delta_angle / 2.0; // global angle
+		// publish the estimate
+		uint32_t now = pros::micros();
+		updateMotion((now - last_motion) / 1e6);
+		last_motion = now;
 
-		// convert to absolute displacement
-		position.x += cos(p) * local_x - sin(p) * local_y;
-		position.y += cos(p) * local_y + sin(p) * local_x;
+		std::array<double, 3> state = ekf::getState();
+		position.x = state[0];
+		position.y = state[1];
+		heading = state[2];
+		recordPose(pros::millis());
+
+		mutex.give();
 
 		if (debug)
 			printf("%.2f, %.2f, %.2f \n", position.x, position.y, getHeading());
@@ -128,17 +1037,416 @@ int odomTask() {
 	}
 }
 
-void reset(Point point) {
+// start the odom task instantiated for the configured sensors
+template <Backend_e_t B, Backend_e_t M> void startTask() {
+	if (imuCount)
+		pros::Task odom_task(odomTask<B, M, true>);
+	else
+		pros::Task odom_task(odomTask<B, M, false>);
+}
+
+// the middle wheel is the same kind of sensor as the left and right, or
+// either kind when they are the motor encoders
+template <Backend_e_t B> void startTask() {
+	if constexpr (B != BACKEND_ROTATION) {
+		if (configData.middleEncoderPort && middleADIEncoder != nullptr) {
+			startTask<B, BACKEND_ADI>();
+			return;
+		}
+	}
+	if constexpr (B != BACKEND_ADI) {
+		if (configData.middleEncoderPort && middleRotation != nullptr) {
+			startTask<B, BACKEND_ROTATION>();
+			return;
+		}
+	}
+	startTask<B, BACKEND_NONE>();
+}
+
+void startTask() {
+	if (configData.encoderType == ENCODER_ADI && leftADIEncoder != nullptr &&
+	    rightADIEncoder != nullptr)
+		startTask<BACKEND_ADI>();
+	else if (leftRotation != nullptr && rightRotation != nullptr)
+		startTask<BACKEND_ROTATION>();
+	else
+		startTask<BACKEND_MOTOR>();
+}
+
+// move the pose estimate to a point, keeping the heading. Must be called with
+// the odom mutex held.
+void resetPosition(Point point) {
 	position.x = point.x;
 	position.y = point.y;
+	ekf::reset(point.x, point.y, heading);
+	history_count = 0;
+	if (mcl_particles)
+		mcl::init(mcl_particles, point.x, point.y, heading, mcl_spread, .02);
+}
+
+void reset(Point point) {
+	mutex.take();
+	resetPosition(point);
+	mutex.give();
+}
+
+int getFailedSensors() {
+	return failed;
+}
+
+int getEvents(uint32_t since) {
+	int events = 0;
+	if (event_time[0] && event_time[0] >= since)
+		events |= EVENT_SLIP;
+	if (event_time[1] && event_time[1] >= since)
+		events |= EVENT_COLLISION;
+	return events;
+}
+
+bool isStationary() {
+	return stationary;
+}
+
+double getImuBias(int index) {
+	if (index < 0 || index >= imuCount)
+		return 0;
+	return -imus[index].bias * 180 / M_PI * 100; // rad per update to deg/s
+}
+
+bool isReady() {
+	return ready;
+}
+
+bool waitUntilReady(uint32_t timeout) {
+	uint32_t start = pros::millis();
+	while (!ready) {
+		if (pros::millis() - start >= timeout)
+			return false;
+		pros::delay(10);
+	}
+	return true;
+}
+
+void printStartupReport() {
+	printf("ARMS startup: devices %d ms", startup.devices - startup.start);
+	for (int i = 0; i < imuCount; i++)
+		printf(", imu %d %d ms", i + 1, startup.imus[i] - startup.start);
+	if (ready)
+		printf(", odom ready %d ms\n", startup.ready - startup.start);
+	else
+		printf(", odom not ready\n");
 }
 
 void reset(Point point, double angle) {
-	reset(point);
+	waitUntilReady(startup_timeout); // imus ignore resets while calibrating
+
+	// the odom task must not publish its old heading part way through
+	mutex.take();
 	heading = angle * M_PI / 180.0;
-	prev_heading = heading;
-	if (imu)
-		imu->set_rotation(-angle);
+	for (int i = 0; i < imuCount; i++) {
+		imus[i].sensor->set_rotation(-angle);
+		imus[i].prev = heading;
+	}
+	resetPosition(point);
+	mutex.give();
+}
+
+ekf::Matrix3 getCovariance() {
+	mutex.take();
+	ekf::Matrix3 P = ekf::getCovariance();
+	mutex.give();
+	return P;
+}
+
+pose_s_t getPoseAt(uint32_t time) {
+	mutex.take();
+	pose_s_t pose = {time, position.x, position.y, heading};
+	if (history_count > 0) {
+		int i = historySearch(time);
+		if (i < 0) {
+			pose = historyAt(0); // older than the history
+		} else if (i == history_count - 1) {
+			pose = historyAt(i); // newer than the history
+		} else {
+			// interpolate between the poses on either side
+			pose_s_t& a = historyAt(i);
+			pose_s_t& b = historyAt(i + 1);
+			double t = (double)(time - a.time) / (b.time - a.time);
+			pose.x = a.x + (b.x - a.x) * t;
+			pose.y = a.y + (b.y - a.y) * t;
+			pose.theta = a.theta + (b.theta - a.theta) * t;
+		}
+	}
+	mutex.give();
+
+	pose.time = time;
+	pose.theta *= 180 / M_PI;
+	return pose;
+}
+
+void correct(pose_s_t measured) {
+	pose_s_t past = getPoseAt(measured.time);
+
+	mutex.take();
+
+	// rigidly move the path travelled since the measurement so that it starts
+	// at the measured pose
+	double d_theta = (measured.theta - past.theta) * M_PI / 180;
+	double c = cos(d_theta);
+	double s = sin(d_theta);
+	auto transform = [&](double& x, double& y, double& theta) {
+		double rx = x - past.x;
+		double ry = y - past.y;
+		x = measured.x + c * rx - s * ry;
+		y = measured.y + s * rx + c * ry;
+		theta += d_theta;
+	};
+
+	std::array<double, 3> state = ekf::getState();
+	std::array<double, 3> moved = state;
+	transform(moved[0], moved[1], moved[2]);
+	ekf::shift(moved[0] - state[0], moved[1] - state[1], moved[2] - state[2]);
+	position.x = moved[0];
+	position.y = moved[1];
+	heading = moved[2];
+
+	// keep the history consistent with the corrected path
+	for (int i = historySearch(measured.time) + 1; i < history_count; i++) {
+		pose_s_t& p = historyAt(i);
+		transform(p.x, p.y, p.theta);
+	}
+
+	// and the particles, which would otherwise pull the estimate back
+	for (int i = 0; mcl_particles && i < mcl::particles.count; i++) {
+		double x = mcl::particles.x[i];
+		double y = mcl::particles.y[i];
+		double theta = mcl::particles.theta[i];
+		transform(x, y, theta);
+		mcl::particles.x[i] = x;
+		mcl::particles.y[i] = y;
+		mcl::particles.theta[i] = theta;
+	}
+
+	mutex.give();
+}
+
+void correct(uint32_t time, Point position) {
+	pose_s_t past = getPoseAt(time);
+	correct({time, position.x, position.y, past.theta});
+}
+
+int relocalize() {
+	mutex.take();
+	int accepted = 0;
+	for (int i = 0; i < distanceSensorCount; i++)
+		accepted += relocalizeSensor(distanceSensors[i], on_demand_gate);
+
+	std::array<double, 3> state = ekf::getState();
+	position.x = state[0];
+	position.y = state[1];
+	mutex.give();
+
+	return accepted;
+}
+
+void initRelocalization(std::initializer_list<std::array<double, 4>> sensors,
+                        bool continuous, int particles) {
+	distanceSensorCount = 0;
+	for (std::array<double, 4> s : sensors) {
+		if (distanceSensorCount >= MAX_DISTANCE_SENSORS) {
+			printf("ARMS ERROR: too many distance sensors\n");
+			break;
+		}
+		distanceSensors[distanceSensorCount++] = {
+		    memory::make<pros::Distance>((int)s[0]), s[1], s[2],
+		    s[3] * M_PI / 180.0};
+	}
+	relocalize_continuous = continuous;
+
+	mutex.take();
+	mcl_particles = particles > MAX_PARTICLES ? MAX_PARTICLES : particles;
+	if (mcl_particles)
+		mcl::init(mcl_particles, position.x, position.y, heading, mcl_spread,
+		          .02);
+	mutex.give();
+}
+
+/**************************************************/
+// calibration
+// return the average of a few distance sensor readings taken while the robot
+// is still, or -1 if none are valid
+double stillDistance(distance_sensor_s_t& s) {
+	double sum = 0;
+	int count = 0;
+	for (int i = 0; i < 5; i++) {
+		double d = readDistance(s);
+		if (d >= 0) {
+			sum += d;
+			count++;
+		}
+		pros::delay(20);
+	}
+	return count ? sum / count : -1;
+}
+
+bool saveCalibration() {
+	FILE* file = fopen(CALIBRATION_FILE, "w");
+	if (file == nullptr) {
+		printf("ARMS ERROR: could not save calibration to %s\n",
+		       CALIBRATION_FILE);
+		return false;
+	}
+	fprintf(file, "%f %f %f %f\n", track_width, left_right_distance,
+	        middle_distance, tpi);
+	fclose(file);
+	return true;
+}
+
+// load the calibrated geometry saved by a previous calibration, if any
+void loadCalibration() {
+	if (!pros::usd::is_installed())
+		return;
+	FILE* file = fopen(CALIBRATION_FILE, "r");
+	if (file == nullptr)
+		return;
+
+	double values[4];
+	int read = fscanf(file, "%lf %lf %lf %lf", &values[0], &values[1],
+	                  &values[2], &values[3]);
+	fclose(file);
+	if (read != 4 || !(values[0] > 0) || !(values[3] > 0)) {
+		printf("ARMS ERROR: invalid calibration in %s\n", CALIBRATION_FILE);
+		return;
+	}
+
+	track_width = values[0];
+	left_right_distance = values[1];
+	middle_distance = values[2];
+	tpi = values[3];
+	printf("ARMS: loaded calibration, track width %.3f, tpi %.3f\n",
+	       track_width, tpi);
+}
+
+bool calibrateTurn(int turns, double speed) {
+	if (!waitUntilReady(startup_timeout) || !std::isfinite(imuRotation())) {
+		printf("ARMS ERROR: turn calibration requires an imu\n");
+		return false;
+	}
+
+	// least squares fit of the encoder ticks per radian, through the origin.
+	// Turning both ways cancels out imu drift, which adds the same rotation
+	// whichever way the robot turns.
+	double tt = 0, lt = 0, rt = 0, mt = 0;
+	for (int dir = 1; dir >= -1; dir -= 2) {
+		double l0 = getLeftEncoder();
+		double r0 = getRightEncoder();
+		double m0 = configData.middleEncoderPort ? getMiddleEncoder() : 0;
+		double a0 = imuRotation();
+		uint32_t start = pros::millis();
+		bool turning = true;
+
+		chassis::tank(-dir * speed, dir * speed);
+		while (true) {
+			double theta = imuRotation() - a0;
+			double l = getLeftEncoder() - l0;
+			double r = getRightEncoder() - r0;
+			double m = configData.middleEncoderPort ? getMiddleEncoder() - m0 : 0;
+			if (std::isfinite(theta)) {
+				tt += theta * theta;
+				lt += theta * l;
+				rt += theta * r;
+				mt += theta * m;
+			}
+
+			// include samples while stopping, they fit the same line
+			if (turning && (fabs(theta) >= turns * M_PI ||
+			                pros::millis() - start > turns * 4000u)) {
+				chassis::tank(0, 0);
+				turning = false;
+				start = pros::millis();
+			}
+			if (!turning && pros::millis() - start > 500)
+				break;
+			pros::delay(10);
+		}
+	}
+
+	if (tt == 0)
+		return false;
+
+	// ticks per radian of each wheel
+	double left = lt / tt;
+	double right = rt / tt;
+	double middle = mt / tt;
+
+	mutex.take();
+	track_width = (right - left) / tpi;
+	left_right_distance = right / tpi;
+	if (configData.middleEncoderPort)
+		middle_distance = -middle / middle_tpi;
+	mutex.give();
+
+	printf("ARMS: calibrated track width %.3f, right offset %.3f, middle "
+	       "distance %.3f\n",
+	       track_width, left_right_distance, middle_distance);
+	saveCalibration();
+	return true;
+}
+
+bool calibrateDrive(double distance, int runs, double speed) {
+	// find a distance sensor facing forward or backward
+	int index = -1;
+	for (int i = 0; i < distanceSensorCount; i++)
+		if (fabs(cos(distanceSensors[i].theta)) > .95)
+			index = i;
+	if (index < 0) {
+		printf("ARMS ERROR: drive calibration requires a distance sensor "
+		       "facing a wall ahead or behind\n");
+		return false;
+	}
+	distance_sensor_s_t& s = distanceSensors[index];
+	waitUntilReady(startup_timeout);
+
+	// least squares fit of the encoder ticks per inch, through the origin,
+	// driving alternately forward and back
+	double dd = 0, dt = 0;
+	for (int i = 0; i < runs; i++) {
+		int dir = i % 2 ? -1 : 1;
+		double d0 = stillDistance(s);
+		double e0 = (getLeftEncoder() + getRightEncoder()) / 2;
+		uint32_t start = pros::millis();
+
+		chassis::tank(dir * speed, dir * speed);
+		while (fabs((getLeftEncoder() + getRightEncoder()) / 2 - e0) / tpi <
+		           distance &&
+		       pros::millis() - start < 5000)
+			pros::delay(10);
+		chassis::tank(0, 0);
+		pros::delay(500);
+
+		double d1 = stillDistance(s);
+		double ticks = (getLeftEncoder() + getRightEncoder()) / 2 - e0;
+		if (d0 < 0 || d1 < 0) {
+			printf("ARMS ERROR: no distance reading during drive calibration\n");
+			continue;
+		}
+
+		// the sensor reading shrinks as the robot drives towards the wall
+		double travelled = -(d1 - d0) / cos(s.theta);
+		dd += travelled * travelled;
+		dt += travelled * ticks;
+	}
+
+	if (dd == 0)
+		return false;
+
+	mutex.take();
+	tpi = dt / dd;
+	mutex.give();
+
+	printf("ARMS: calibrated tpi %.3f\n", tpi);
+	saveCalibration();
+	return true;
 }
 
 Point getPosition() {
@@ -151,6 +1459,21 @@ double getHeading(bool radians) {
 	return heading * 180 / M_PI;
 }
 
+// convert a rate in radians to degrees
+motion_s_t toDegrees(motion_s_t m, bool radians) {
+	if (!radians)
+		m.theta *= 180 / M_PI;
+	return m;
+}
+
+motion_s_t getVelocity(bool body, bool radians) {
+	return toDegrees(body ? body_velocity : field_velocity, radians);
+}
+
+motion_s_t getAcceleration(bool body, bool radians) {
+	return toDegrees(body ? body_acceleration : field_acceleration, radians);
+}
+
 double getAngleError(Point point) {
 	double x = point.x;
 	double y = point.y;
@@ -183,17 +1506,20 @@ double getDistanceError(Point point) {
 }
 
 void init(bool debug, EncoderType_e_t encoderType,
-          std::array<int, 3> encoderPorts, int expanderPort, int imuPort,
+          std::array<int, 3> encoderPorts, int expanderPort,
+          std::initializer_list<int> imuPorts,
           double track_width, double middle_distance, double tpi,
-          double middle_tpi) {
+          double middle_tpi, int substeps, int gpsPort,
+          std::array<double, 2> gpsOffset) {
 	odom::debug = debug;
 	odom::track_width = track_width;
 	odom::left_right_distance = track_width / 2;
 	odom::middle_distance = middle_distance;
 	odom::tpi = tpi;
 	odom::middle_tpi = middle_tpi;
-
-	pros::Task odom_task(odomTask);
+	odom::substeps = substeps > 0 ? substeps : 1;
+	startup.start = pros::millis();
+	loadCalibration();
 
 	configData.expanderPort = expanderPort;
 	configData.leftEncoderPort = encoderPorts[0];
@@ -206,36 +1532,36 @@ void init(bool debug, EncoderType_e_t encoderType,
 	case ENCODER_ADI:
 		if (expanderPort == 0) {
 			if (configData.leftEncoderPort != 0) {
-				leftADIEncoder = std::make_shared<pros::ADIEncoder>(
+				leftADIEncoder = memory::make<pros::ADIEncoder>(
 				    abs(configData.leftEncoderPort),
 				    abs(configData.leftEncoderPort) + 1,
 				    configData.leftEncoderPort < 0);
-				rightADIEncoder = std::make_shared<pros::ADIEncoder>(
+				rightADIEncoder = memory::make<pros::ADIEncoder>(
 				    abs(configData.rightEncoderPort),
 				    abs(configData.rightEncoderPort) + 1,
 				    configData.rightEncoderPort < 0);
 			}
 			if (configData.middleEncoderPort != 0) {
-				middleADIEncoder = std::make_shared<pros::ADIEncoder>(
+				middleADIEncoder = memory::make<pros::ADIEncoder>(
 				    abs(configData.middleEncoderPort),
 				    abs(configData.middleEncoderPort) + 1,
 				    configData.middleEncoderPort < 0);
 			}
 		} else {
 			if (configData.leftEncoderPort != 0) {
-				leftADIEncoder = std::make_shared<pros::ADIEncoder>(
+				leftADIEncoder = memory::make<pros::ADIEncoder>(
 				    std::tuple<int, int, int>({expanderPort,
 				                               abs(configData.leftEncoderPort),
 				                               abs(configData.leftEncoderPort) + 1}),
 				    configData.leftEncoderPort < 0);
-				rightADIEncoder = std::make_shared<pros::ADIEncoder>(
+				rightADIEncoder = memory::make<pros::ADIEncoder>(
 				    std::tuple<int, int, int>({expanderPort,
 				                               abs(configData.rightEncoderPort),
 				                               abs(configData.rightEncoderPort) + 1}),
 				    configData.rightEncoderPort < 0);
 			}
 			if (configData.middleEncoderPort != 0) {
-				middleADIEncoder = std::make_shared<pros::ADIEncoder>(
+				middleADIEncoder = memory::make<pros::ADIEncoder>(
 				    std::tuple<int, int, int>({expanderPort,
 				                               abs(configData.middleEncoderPort),
 				                               abs(configData.middleEncoderPort) + 1}),
@@ -245,28 +1571,59 @@ void init(bool debug, EncoderType_e_t encoderType,
 		break;
 	case ENCODER_ROTATION:
 		if (configData.leftEncoderPort != 0) {
-			leftRotation = std::make_shared<pros::Rotation>(
+			leftRotation = memory::make<pros::Rotation>(
 			    abs(configData.leftEncoderPort), configData.leftEncoderPort < 0);
-			rightRotation = std::make_shared<pros::Rotation>(
+			rightRotation = memory::make<pros::Rotation>(
 			    abs(configData.rightEncoderPort), configData.rightEncoderPort < 0);
 		}
 		if (configData.middleEncoderPort != 0)
-			middleRotation = std::make_shared<pros::Rotation>(
+			middleRotation = memory::make<pros::Rotation>(
 			    abs(configData.middleEncoderPort), configData.middleEncoderPort < 0);
 		break;
 	default:
 		break;
 	}
-	// initialize imu
-	if (imuPort != 0) {
-		imu = std::make_shared<pros::Imu>(imuPort);
-		int rtn = imu->reset(true);
+	// initialize gps
+	if (gpsPort != 0) {
+		gps = memory::make<pros::Gps>(gpsPort);
+		gps_offset[0] = gpsOffset[0];
+		gps_offset[1] = gpsOffset[1];
+	}
+
+	// initialize imus
+	for (int port : imuPorts) {
+		if (port == 0)
+			continue;
+		if (imuCount >= MAX_IMUS) {
+			printf("ARMS ERROR: too many imus\n");
+			break;
+		}
+
+		// calibrate every imu at once without blocking, the odom task waits for
+		// them to finish
+		std::shared_ptr<pros::Imu> sensor = memory::make<pros::Imu>(port);
+		int rtn = sensor->reset(false);
 		if (rtn != 1) {
 			printf("ARMS ERROR: IMU reset failed with error code %d", errno);
 		}
+		imus[imuCount++] = {sensor, 0, false, 0, 1};
 	}
-	pros::delay(100);
-	reset();
+	if (imuCount)
+		imu = imus[0].sensor;
+
+	lv_task_create(showWarning, 100, LV_TASK_PRIO_LOW, nullptr);
+
+	startup.devices = pros::millis();
+
+	// start at the origin before the task does, so that a reset() made while
+	// the sensors start up is kept
+	position.x = 0;
+	position.y = 0;
+	heading = 0;
+	ekf::reset(0, 0, 0);
+
+	// start integrating once the devices are constructed
+	startTask();
 }
 
 } // namespace arms::odom
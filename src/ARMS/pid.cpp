@@ -16,10 +16,14 @@ double angularKD;
 double trackingKP;
 double minError;
 double leadPct;
+double velocityKF;
+double velocityKP;
+double velocityKI;
 
 // integral
 double in_lin;
 double in_ang;
+double in_vel[2];
 
 // kp defaults
 double defaultLinearKP;
@@ -147,6 +151,40 @@ std::array<double, 2> translational() {
 	return {left_speed, right_speed};
 }
 
+std::array<double, 3> holonomic() {
+	// previous errors
+	static double pe_lin = 0;
+	static double pe_ang = 0;
+
+	if (linearKP == -1)
+		linearKP = defaultLinearKP;
+	if (trackingKP == -1)
+		trackingKP = defaultTrackingKP;
+
+	// the robot drives straight at the target, turning at the same time
+	Point p = odom::getPosition();
+	double dx = pointTarget.x - p.x;
+	double dy = pointTarget.y - p.y;
+	double lin_error = odom::getDistanceError(pointTarget);
+
+	double lin_speed;
+	if (thru)
+		lin_speed = chassis::maxSpeed;
+	else
+		lin_speed = pid(lin_error, &pe_lin, &in_lin, linearKP, linearKI, linearKD);
+	if (lin_speed > chassis::maxSpeed)
+		lin_speed = chassis::maxSpeed;
+
+	double poseError = (angularTarget * M_PI / 180) - odom::getHeading(true);
+	poseError = remainder(poseError, 2 * M_PI);
+	double ang_speed = pid(poseError, &pe_ang, &in_ang, trackingKP, 0, 0);
+
+	// direction of the target in the robot frame
+	double direction = atan2(dy, dx) - odom::getHeading(true);
+
+	return {lin_speed * cos(direction), lin_speed * sin(direction), ang_speed};
+}
+
 std::array<double, 2> angular() {
 	static double pe = 0; // previous error
 
@@ -159,9 +197,21 @@ std::array<double, 2> angular() {
 	return {-speed, speed}; // clockwise positive
 }
 
+double velocity(double target, double measured, double* in) {
+	double error = target - measured;
+
+	// limit the integral so it can never saturate the output on its own
+	*in += error;
+	if (velocityKI != 0 && fabs(*in * velocityKI) > 100)
+		*in = 100 / velocityKI * (*in > 0 ? 1 : -1);
+
+	return target * velocityKF + error * velocityKP + *in * velocityKI;
+}
+
 void init(double linearKP, double linearKI, double linearKD, double angularKP,
           double angularKI, double angularKD, double trackingKP,
-          double minError, double leadPct) {
+          double minError, double leadPct, double velocityKF, double velocityKP,
+          double velocityKI) {
 
 	pid::defaultLinearKP = linearKP;
 	pid::linearKI = linearKI;
@@ -172,6 +222,9 @@ void init(double linearKP, double linearKI, double linearKD, double angularKP,
 	pid::defaultTrackingKP = trackingKP;
 	pid::minError = minError;
 	pid::leadPct = leadPct;
+	pid::velocityKF = velocityKF;
+	pid::velocityKP = velocityKP;
+	pid::velocityKI = velocityKI;
 }
 
 } // namespace arms::pid
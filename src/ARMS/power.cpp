@@ -0,0 +1,171 @@
+#include "ARMS/power.h"
+
+namespace arms::power {
+
+load_s_t loads[MAX_LOADS];
+int loadCount = 0;
+
+// budgets, 0 for no limit
+double current_budget = 0;
+double power_budget = 0;
+
+// measured totals
+double current = 0;
+double power = 0;
+
+// The scale drops in proportion to how far over budget the loads are and
+// recovers at a fixed rate, so it settles just under the budget instead of
+// oscillating around it. Current lags the command by a few ticks.
+double scale = 1;
+const double scale_gain = .5;      // fraction of the overage removed per tick
+const double scale_recovery = .02; // scale regained per tick under budget
+const double headroom = .9;        // recover only below this fraction
+
+// thermal model, a first order heating and cooling of each motor. At a
+// constant current the temperature approaches ambient + heat_gain * I^2 *
+// thermal_tau, about 60 C above ambient at the 2.5 A stall current.
+const double ambient = 25;        // C
+const double heat_gain = .032;    // C per A^2 per second
+const double thermal_tau = 300;   // cooling time constant (s)
+const double throttle_temp = 55;  // firmware halves the current limit (C)
+const double derate_temp = 45;    // start derating at this estimate (C)
+const double derate_horizon = 60; // derate if throttling is predicted within
+                                  // this many seconds
+double prev_update = 0;           // time of the last update (s)
+
+// firmware current limit as a fraction of full, by temperature
+double firmwareLimit(double temperature) {
+	if (temperature < 55)
+		return 1;
+	if (temperature < 60)
+		return .5;
+	if (temperature < 65)
+		return .25;
+	if (temperature < 70)
+		return .125;
+	return 0;
+}
+
+// advance a motor's estimated temperature by dt seconds and return the
+// fraction of full output it can use
+double updateThermal(load_s_t& load, int i, double amps, double reported,
+                     double dt) {
+	double& t = load.temperature[i];
+	if (!load.modelled[i]) {
+		t = reported != PROS_ERR_F ? reported : ambient;
+		load.modelled[i] = true;
+	}
+
+	double steady = ambient + heat_gain * amps * amps * thermal_tau;
+	t += (steady - t) * (1 - exp(-dt / thermal_tau));
+
+	// reported temperatures are rounded down to multiples of 5
+	if (reported != PROS_ERR_F)
+		t = fmin(fmax(t, reported), reported + 5);
+
+	// derate smoothly as the motor approaches the throttling temperature
+	double derating = firmwareLimit(t);
+	if (t < throttle_temp)
+		derating = fmin(1, 1 - .5 * (t - derate_temp) /
+		                           (throttle_temp - derate_temp));
+
+	// and earlier if the present draw will reach it soon
+	if (t < throttle_temp && steady > throttle_temp) {
+		double time = -thermal_tau * log((throttle_temp - steady) / (t - steady));
+		derating = fmin(derating, .5 + .5 * fmin(time / derate_horizon, 1));
+	}
+
+	return derating;
+}
+
+int addLoad(std::shared_ptr<pros::Motor_Group> motors) {
+	if (loadCount >= MAX_LOADS) {
+		printf("ARMS ERROR: too many loads in the power budget\n");
+		return -1;
+	}
+	loads[loadCount].motors = motors;
+	return loadCount++;
+}
+
+// return how far over budget a measurement is, as a fraction of the budget
+double overage(double measured, double budget) {
+	return budget > 0 ? measured / budget - 1 : -1;
+}
+
+void update() {
+	double now = pros::millis() / 1000.0;
+	double dt = prev_update > 0 ? now - prev_update : 0;
+	prev_update = now;
+
+	current = 0;
+	power = 0;
+	for (int i = 0; i < loadCount; i++) {
+		load_s_t& load = loads[i];
+		load.current = 0;
+		load.power = 0;
+		load.derating = 1;
+
+		// read each motor rather than through the group, which returns vectors
+		int count = load.motors->size();
+		for (int j = 0; j < count; j++) {
+			pros::Motor& motor = (*load.motors)[j];
+			int32_t current = motor.get_current_draw();
+			if (current == PROS_ERR)
+				continue; // unplugged
+			if (j < MAX_LOAD_MOTORS)
+				load.derating = fmin(load.derating,
+				                     updateThermal(load, j, current / 1000.0,
+				                                   motor.get_temperature(), dt));
+			load.current += abs(current);
+			int32_t voltage = motor.get_voltage();
+			if (voltage != PROS_ERR)
+				load.power += fabs(current / 1000.0 * voltage / 1000.0);
+		}
+		current += load.current;
+		power += load.power;
+	}
+
+	double over = fmax(overage(current, current_budget),
+	                   overage(power, power_budget));
+	if (over > 0)
+		scale = fmax(scale * (1 - scale_gain * over / (1 + over)), .1);
+	else if (over < headroom - 1)
+		scale = fmin(scale + scale_recovery, 1);
+}
+
+double getDerating(int index) {
+	if (index >= 0)
+		return index < loadCount ? loads[index].derating : 1;
+
+	double derating = 1;
+	for (int i = 0; i < loadCount; i++)
+		derating = fmin(derating, loads[i].derating);
+	return derating;
+}
+
+double getTemperature(int index, int motor) {
+	if (index < 0 || index >= loadCount || motor < 0 ||
+	    motor >= MAX_LOAD_MOTORS || !loads[index].modelled[motor])
+		return PROS_ERR_F;
+	return loads[index].temperature[motor];
+}
+
+double getScale() {
+	return scale;
+}
+
+double getCurrent() {
+	return current;
+}
+
+double getPower() {
+	return power;
+}
+
+void init(double current_budget, double power_budget) {
+	power::current_budget = current_budget;
+	power::power_budget = power_budget;
+	scale = 1;
+}
+
+} // namespace arms::power
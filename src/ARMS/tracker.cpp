@@ -0,0 +1,19 @@
+#include "ARMS/tracker.h"
+
+namespace arms::tracker {
+
+void update(tracker_s_t& t, double measured, double dt, gains_s_t gains) {
+	if (!t.valid || dt <= 0) {
+		t = {measured, 0, 0, true};
+		return;
+	}
+
+	double predicted =
+	    t.position + t.velocity * dt + t.acceleration * dt * dt / 2;
+	double residual = measured - predicted;
+	t.position = predicted + gains.alpha * residual;
+	t.velocity += t.acceleration * dt + gains.beta * residual / dt;
+	t.acceleration += 2 * gains.gamma * residual / (dt * dt);
+}
+
+} // namespace arms::tracker
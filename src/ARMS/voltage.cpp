@@ -0,0 +1,19 @@
+#include "ARMS/voltage.h"
+
+namespace arms::voltage {
+
+double compensate(double command, double nominal, double battery) {
+	if (nominal > 0 && battery > 0)
+		return command * nominal / battery;
+	return command;
+}
+
+double filter(double filtered, double reading, double gain) {
+	if (reading <= 0 || reading > 20)
+		return filtered; // PROS_ERR or no reading
+	if (filtered == 0)
+		return reading;
+	return filtered + (reading - filtered) * gain;
+}
+
+} // namespace arms::voltage
@@ -0,0 +1,152 @@
+#include "test.h"
+
+#include <memory>
+
+// Compare the per-update cost of choosing the odometry sensors at runtime,
+// as the odom task did before it was instantiated for the configured sensors,
+// with the templated task. The sensors are stubs with virtual reads like the
+// PROS devices, so only the dispatch around the reads differs.
+
+struct Encoder {
+	int ticks = 0;
+	virtual __attribute__((noinline)) int get_value() {
+		return ticks += 3;
+	}
+	virtual ~Encoder() = default;
+};
+
+struct Rotation {
+	int ticks = 0;
+	virtual __attribute__((noinline)) int get_position() {
+		return ticks += 5;
+	}
+	virtual ~Rotation() = default;
+};
+
+typedef enum { ENCODER_ADI, ENCODER_ROTATION } EncoderType_e_t;
+typedef enum { BACKEND_ADI, BACKEND_ROTATION, BACKEND_NONE } Backend_e_t;
+
+// configuration, set at runtime so that it cannot be folded away
+EncoderType_e_t encoderType;
+int middleEncoderPort;
+std::shared_ptr<Encoder> leftADI, rightADI, middleADI;
+std::shared_ptr<Rotation> leftRotation, rightRotation, middleRotation;
+bool motorFailover = false;
+int failed = 0;
+
+/**************************************************/
+// runtime dispatch
+double getLeft() {
+	if (motorFailover)
+		return 0;
+	else if (encoderType == ENCODER_ADI && leftADI != nullptr)
+		return leftADI->get_value();
+	else if (leftRotation != nullptr)
+		return leftRotation->get_position();
+	return 0;
+}
+
+double getRight() {
+	if (motorFailover)
+		return 0;
+	else if (encoderType == ENCODER_ADI && rightADI != nullptr)
+		return rightADI->get_value();
+	else if (rightRotation != nullptr)
+		return rightRotation->get_position();
+	return 0;
+}
+
+double getMiddle() {
+	if (failed & 4)
+		return 0;
+	else if (encoderType == ENCODER_ADI && middleADI != nullptr)
+		return middleADI->get_value();
+	else if (middleRotation != nullptr)
+		return middleRotation->get_position();
+	return 0;
+}
+
+bool hasTrackingWheels() {
+	if (motorFailover)
+		return false;
+	if (encoderType == ENCODER_ADI)
+		return leftADI != nullptr && rightADI != nullptr;
+	return leftRotation != nullptr && rightRotation != nullptr;
+}
+
+double runtimeUpdate() {
+	double sum = getLeft() + getRight() + getMiddle();
+	sum += hasTrackingWheels();                  // checkSensors()
+	sum += middleEncoderPort && !(failed & 4);   // checkSensors()
+	sum += hasTrackingWheels();                  // detectEvents()
+	sum += hasTrackingWheels();                  // slip handling
+	return sum;
+}
+
+/**************************************************/
+// templated
+template <Backend_e_t B> double readLeft() {
+	if (motorFailover)
+		return 0;
+	if constexpr (B == BACKEND_ADI)
+		return leftADI->get_value();
+	else
+		return leftRotation->get_position();
+}
+
+template <Backend_e_t B> double readRight() {
+	if (motorFailover)
+		return 0;
+	if constexpr (B == BACKEND_ADI)
+		return rightADI->get_value();
+	else
+		return rightRotation->get_position();
+}
+
+template <Backend_e_t M> double readMiddle() {
+	if constexpr (M == BACKEND_NONE)
+		return 0;
+	else if (failed & 4)
+		return 0;
+	else if constexpr (M == BACKEND_ADI)
+		return middleADI->get_value();
+	else
+		return middleRotation->get_position();
+}
+
+template <Backend_e_t B> bool tracking() {
+	return !motorFailover;
+}
+
+template <Backend_e_t B, Backend_e_t M> double templatedUpdate() {
+	double sum = readLeft<B>() + readRight<B>() + readMiddle<M>();
+	sum += tracking<B>();
+	sum += M != BACKEND_NONE && !(failed & 4);
+	sum += tracking<B>();
+	sum += tracking<B>();
+	return sum;
+}
+
+int main(int argc, char** argv) {
+	// rotation sensors, the last case the runtime dispatch reaches
+	encoderType = argc > 5 ? ENCODER_ADI : ENCODER_ROTATION;
+	middleEncoderPort = 3;
+	leftRotation = std::make_shared<Rotation>();
+	rightRotation = std::make_shared<Rotation>();
+	middleRotation = std::make_shared<Rotation>();
+
+	const int n = 20000000;
+	double a = 0, b = 0;
+	double runtime_ns = timeEach(n, [&](int) { a += runtimeUpdate(); });
+	leftRotation->ticks = rightRotation->ticks = middleRotation->ticks = 0;
+	double templated_ns = timeEach(n, [&](int) {
+		b += templatedUpdate<BACKEND_ROTATION, BACKEND_ROTATION>();
+	});
+
+	printf("odom sensor dispatch per update (ns): runtime %.2f, templated "
+	       "%.2f (%.0f%% less)\n",
+	       runtime_ns, templated_ns, 100 * (1 - templated_ns / runtime_ns));
+	CHECK(a == b, "the two versions read different values");
+
+	return report("dispatch_bench");
+}
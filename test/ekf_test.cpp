@@ -0,0 +1,105 @@
+#include "ARMS/arc.h"
+#include "ARMS/ekf.h"
+#include "test.h"
+
+#include <cmath>
+#include <random>
+
+// Feed the pose EKF simulated tracking wheel, imu and GPS streams, as the
+// odom task does, and check it against the true path.
+
+using namespace arms;
+
+const double dt = .01;            // odometry update period (s)
+const int gps_every = 5;          // odometry updates per gps fix (50 ms)
+const double gps_sigma = .5;      // gps position noise (in)
+const double gps_heading_var = .0012;
+const double linear_noise = .01;  // as in odom.cpp
+const double imu_angular_noise = .0005;
+
+std::mt19937 rng(7);
+std::normal_distribution<double> normal(0, 1);
+
+double trace(const ekf::Matrix3& P) {
+	return P[0][0] + P[1][1] + P[2][2];
+}
+
+int main() {
+	// the robot starts somewhere in the GPS frame, but the odometry starts at
+	// the origin with no uncertainty. A fix there fails the gate, which is why
+	// the odom task sets the pose from the first fix.
+	std::array<double, 3> truth = {-40, -50, .3};
+	ekf::reset(0, 0, 0);
+	CHECK(ekf::updatePose(truth[0], truth[1], truth[2], .25, gps_heading_var) ==
+	          0,
+	      "a fix far from a certain estimate was accepted");
+
+	ekf::reset(truth[0] + gps_sigma * normal(rng),
+	           truth[1] + gps_sigma * normal(rng), truth[2], .25,
+	           gps_heading_var);
+
+	// drive a weaving path for 20 s. The wheels read 3% long and the imu
+	// heading is noisy, so odometry alone drifts.
+	std::array<double, 3> odom_only = ekf::getState();
+	double worst = 0;
+	int accepted = 0, fixes = 0;
+	for (int i = 0; i < 2000; i++) {
+		double t = i * dt;
+		double forward = 40 * dt;
+		double turn = 1.2 * sin(t) * dt;
+		std::array<double, 2> local = arc::chord(forward, 0, turn, 0, 0);
+		arc::apply(truth, local[0], local[1], turn);
+
+		double measured_turn = turn + .002 * normal(rng);
+		std::array<double, 2> m =
+		    arc::chord(forward * 1.03, 0, measured_turn, 0, 0);
+		double distance = fabs(m[0]) + fabs(m[1]);
+		ekf::predict(m[0], m[1], measured_turn, linear_noise * distance,
+		             imu_angular_noise * fabs(measured_turn));
+		arc::apply(odom_only, m[0], m[1], measured_turn);
+
+		if (i % gps_every == 0) {
+			ekf::Matrix3 before = ekf::getCovariance();
+			int n = ekf::updatePose(truth[0] + gps_sigma * normal(rng),
+			                        truth[1] + gps_sigma * normal(rng),
+			                        truth[2] + .035 * normal(rng),
+			                        gps_sigma * gps_sigma, gps_heading_var);
+			accepted += n;
+			fixes++;
+			if (n == 3)
+				CHECK(trace(ekf::getCovariance()) < trace(before),
+				      "a fix did not shrink the covariance");
+		}
+
+		std::array<double, 3> s = ekf::getState();
+		if (i >= 200)
+			worst = fmax(worst, hypot(s[0] - truth[0], s[1] - truth[1]));
+	}
+
+	std::array<double, 3> s = ekf::getState();
+	double error = hypot(s[0] - truth[0], s[1] - truth[1]);
+	double drift = hypot(odom_only[0] - truth[0], odom_only[1] - truth[1]);
+	printf("ekf after 20 s: error %.2f in (worst %.2f), odometry alone %.2f "
+	       "in, %d of %d gps components accepted\n",
+	       error, worst, drift, accepted, fixes * 3);
+	CHECK(worst < 1.5, "the estimate strayed %.2f in from the path", worst);
+	CHECK(error < drift / 5, "gps fixes did not correct the odometry drift");
+	CHECK(accepted > fixes * 3 * .95, "too many good fixes were rejected");
+
+	// the covariance settles well below the gps variance
+	ekf::Matrix3 P = ekf::getCovariance();
+	printf("ekf position variance %.3f in^2, heading variance %.5f rad^2\n",
+	       P[0][0], P[2][2]);
+	CHECK(P[0][0] < gps_sigma * gps_sigma && P[1][1] < gps_sigma * gps_sigma,
+	      "the position variance did not settle below the gps variance");
+
+	// a fix 30 inches away is an outlier and leaves the estimate alone
+	s = ekf::getState();
+	int n = ekf::updatePose(s[0] + 30, s[1] - 30, s[2], .25, gps_heading_var);
+	std::array<double, 3> after = ekf::getState();
+	CHECK(n == 1, "the outlier's position passed the gate (%d accepted)", n);
+	CHECK(fabs(after[0] - s[0]) < .01 && fabs(after[1] - s[1]) < .01,
+	      "the outlier moved the estimate");
+
+	return report("ekf_test");
+}
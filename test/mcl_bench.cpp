@@ -0,0 +1,77 @@
+#include "ARMS/field.h"
+#include "ARMS/mcl.h"
+#include "test.h"
+
+#include <cmath>
+#include <random>
+
+// Time the particle filter with 500 particles and 4 distance sensors, and
+// check that it tracks a simulated robot driving around the field.
+
+using namespace arms;
+
+const int particles = 500;
+const int steps = 2000; // 20 ms updates, 40 s
+
+// distance sensors {x, y, angle} relative to the robot, facing each way
+const double sensors[4][3] = {
+    {6, 0, 0}, {0, 6, M_PI / 2}, {-6, 0, M_PI}, {0, -6, -M_PI / 2}};
+
+int main() {
+	field::addRectangle({-72, -72}, {72, 72});
+	field::addRectangle({-12, -12}, {12, 12}); // a goal in the middle
+
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(0, 1);
+
+	double x = 0, y = -48, theta = 0;
+	mcl::init(particles, x, y, theta, 2, .02);
+
+	double predict_ns = 0, update_ns = 0, resample_ns = 0;
+	double worst = 0;
+	for (int i = 0; i < steps; i++) {
+		// drive a 48 inch circle around the goal
+		double turn = .02 * .5;
+		double forward = .02 * 24;
+		double local_x = forward;
+		double p = theta + turn / 2;
+		x += cos(p) * forward;
+		y += sin(p) * forward;
+		theta += turn;
+
+		// odometry with 5% noise
+		predict_ns += timeEach(1, [&](int) {
+			mcl::predict(local_x * (1 + .05 * noise(rng)), 0, turn, .05, .05);
+		});
+
+		for (auto& s : sensors) {
+			double c = cos(theta), sn = sin(theta);
+			double d = field::raycast(x + c * s[0] - sn * s[1],
+			                          y + sn * s[0] + c * s[1], theta + s[2]);
+			if (d < 0 || d > 78)
+				continue;
+			double sigma = fmax(.6, .05 * d);
+			double measured = d + sigma * noise(rng);
+			update_ns += timeEach(1, [&](int) {
+				mcl::update(s[0], s[1], s[2], measured, sigma);
+			});
+		}
+
+		resample_ns += timeEach(1, [&](int) { mcl::resample(); });
+
+		if (i > steps / 10) {
+			std::array<double, 3> e = mcl::estimate();
+			worst = fmax(worst, hypot(e[0] - x, e[1] - y));
+		}
+	}
+
+	printf("mcl %d particles, 4 sensors, per update (us): predict %.1f, "
+	       "update %.1f, resample %.1f, total %.1f\n",
+	       particles, predict_ns / steps / 1000, update_ns / steps / 1000,
+	       resample_ns / steps / 1000,
+	       (predict_ns + update_ns + resample_ns) / steps / 1000);
+	printf("mcl worst position error after settling: %.2f in\n", worst);
+	CHECK(worst < 3, "particle filter lost the robot by %.2f in", worst);
+
+	return report("mcl_bench");
+}
@@ -0,0 +1,137 @@
+#include "ARMS/arc.h"
+#include "test.h"
+
+#include <array>
+#include <cmath>
+
+// Compare odometry integration against a simulated robot with a known path.
+// The robot's body frame velocity changes smoothly over time, and the ground
+// truth and wheel travel are integrated from it in fine steps.
+
+using namespace arms;
+
+const double dt = .01;             // odometry update period (s)
+const int fine = 1000;             // ground truth steps per update
+const double right_offset = 6;     // right wheel to the right of center (in)
+const double middle_distance = 3;  // middle wheel behind center (in)
+const double duration = 15;        // length of each run (s)
+
+// body frame velocity {forward (in/s), left (in/s), turn (rad/s)} at time t
+typedef std::array<double, 3> (*Profile)(double t);
+
+// constant curvature arc
+std::array<double, 3> constantArc(double t) {
+	return {40, 0, 1.5};
+}
+
+// accelerating and weaving, as on a fast robot
+std::array<double, 3> weaving(double t) {
+	double v = 70 * fmin(t, 1);
+	return {v, 6 * sin(1.3 * t), 4 * sin(2 * M_PI * t / 3)};
+}
+
+// one update of wheel travel and the true pose at its end
+typedef struct step_s {
+	double right, middle, angle;
+} step_s_t;
+
+// integrate the profile over one update starting at time t, moving truth and
+// returning the wheel travel
+step_s_t simulate(Profile profile, double t, std::array<double, 3>& truth) {
+	step_s_t step = {0, 0, 0};
+	double h = dt / fine;
+	for (int i = 0; i < fine; i++) {
+		std::array<double, 3> v = profile(t + (i + .5) * h); // midpoint rule
+		double p = truth[2] + v[2] * h / 2;
+		truth[0] += (cos(p) * v[0] - sin(p) * v[1]) * h;
+		truth[1] += (sin(p) * v[0] + cos(p) * v[1]) * h;
+		truth[2] += v[2] * h;
+		step.right += (v[0] + right_offset * v[2]) * h;
+		step.middle += (v[1] - middle_distance * v[2]) * h;
+		step.angle += v[2] * h;
+	}
+	return step;
+}
+
+// straight line steps in the direction of the starting heading, for
+// comparison
+void euler(std::array<double, 3>& pose, step_s_t s) {
+	double x = s.right - right_offset * s.angle;
+	double y = s.middle + middle_distance * s.angle;
+	pose[0] += cos(pose[2]) * x - sin(pose[2]) * y;
+	pose[1] += sin(pose[2]) * x + cos(pose[2]) * y;
+	pose[2] += s.angle;
+}
+
+// integrate a step as the odom task does, in substeps arcs
+void arcs(std::array<double, 3>& pose, step_s_t s, step_s_t prev,
+          int substeps) {
+	for (int i = 0; i < substeps; i++) {
+		double r = arc::substepWeight(i, substeps, s.right, prev.right);
+		double m = arc::substepWeight(i, substeps, s.middle, prev.middle);
+		double a = arc::substepWeight(i, substeps, s.angle, prev.angle);
+		std::array<double, 2> local = arc::chord(
+		    s.right * r, s.middle * m, s.angle * a, right_offset, middle_distance);
+		arc::apply(pose, local[0], local[1], s.angle * a);
+	}
+}
+
+// run a profile, returning the final position error of each integrator:
+// euler, one arc, and four sub-stepped arcs
+std::array<double, 3> drift(Profile profile) {
+	std::array<double, 3> truth = {0, 0, 0};
+	std::array<std::array<double, 3>, 3> pose = {};
+	step_s_t prev = {0, 0, 0};
+	for (double t = 0; t < duration - dt / 2; t += dt) {
+		step_s_t s = simulate(profile, t, truth);
+		euler(pose[0], s);
+		arcs(pose[1], s, prev, 1);
+		arcs(pose[2], s, prev, 4);
+		prev = s;
+	}
+
+	std::array<double, 3> error;
+	for (int i = 0; i < 3; i++)
+		error[i] = hypot(pose[i][0] - truth[0], pose[i][1] - truth[1]);
+	return error;
+}
+
+int main() {
+	// the chord ratio is continuous where the Taylor series takes over
+	CHECK(fabs(arc::chordRatio(.0099999) - arc::chordRatio(.0100001)) < 1e-9,
+	      "chord ratio is discontinuous at the series cutoff");
+	CHECK(arc::chordRatio(0) == 1, "chord ratio of a straight line is not 1");
+
+	// an exact arc matches a constant curvature path to rounding error
+	std::array<double, 3> arc_error = drift(constantArc);
+	printf("constant arc drift (in): euler %.4f, arc %.2e, 4 substeps %.2e\n",
+	       arc_error[0], arc_error[1], arc_error[2]);
+	CHECK(arc_error[1] < 1e-6, "arc drifts %g in on a constant arc",
+	      arc_error[1]);
+	CHECK(arc_error[0] > 100 * arc_error[1],
+	      "arc is not more accurate than euler steps");
+
+	// with changing curvature the arcs still drift far less than straight
+	// steps, and sub-steps reduce the drift further
+	std::array<double, 3> weave_error = drift(weaving);
+	printf("weaving drift (in): euler %.4f, arc %.4f, 4 substeps %.4f\n",
+	       weave_error[0], weave_error[1], weave_error[2]);
+	CHECK(weave_error[1] < .25, "arc drifts %g in while weaving",
+	      weave_error[1]);
+	CHECK(weave_error[1] < weave_error[0] / 5,
+	      "arc is not more accurate than euler steps while weaving");
+	CHECK(weave_error[2] <= weave_error[1],
+	      "sub-steps do not reduce the drift while weaving");
+
+	// cost of one update
+	std::array<double, 3> pose = {0, 0, 0};
+	step_s_t s = {.5, .02, .03};
+	double euler_ns = timeEach(1000000, [&](int) { euler(pose, s); });
+	double arc_ns = timeEach(1000000, [&](int) { arcs(pose, s, s, 1); });
+	double sub_ns = timeEach(1000000, [&](int) { arcs(pose, s, s, 4); });
+	printf("update cost (ns): euler %.1f, arc %.1f, 4 substeps %.1f "
+	       "(pose %.0f)\n",
+	       euler_ns, arc_ns, sub_ns, pose[0]);
+
+	return report("odom_test");
+}
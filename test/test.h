@@ -0,0 +1,40 @@
+#ifndef _ARMS_TEST_H_
+#define _ARMS_TEST_H_
+
+#include <chrono>
+#include <cstdio>
+
+// Minimal host test helpers. A failed check is printed and makes the test
+// program return non-zero; results are printed so that runs can be compared.
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                        \
+	do {                                                                          \
+		if (!(cond)) {                                                              \
+			printf("FAIL %s:%d: ", __FILE__, __LINE__);                              \
+			printf(__VA_ARGS__);                                                      \
+			printf("\n");                                                             \
+			failures++;                                                               \
+		}                                                                           \
+	} while (0)
+
+// return the time taken by each of n calls to f, in nanoseconds
+template <class F> double timeEach(int n, F f) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < n; i++)
+		f(i);
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / n;
+}
+
+// print the result of a test program and return its exit code
+static int report(const char* name) {
+	if (failures)
+		printf("%s: %d check(s) failed\n", name, failures);
+	else
+		printf("%s: passed\n", name);
+	return failures != 0;
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include "ARMS/tracker.h"
+#include "test.h"
+
+#include <cmath>
+
+// Check the step response of the odometry velocity and acceleration filter
+// against the lag and overshoot documented for tracker::odom_gains.
+
+using namespace arms;
+
+const double dt = .01; // odometry update period (s)
+
+int main() {
+	tracker::gains_s_t gains = tracker::odom_gains;
+
+	// velocity step: still, then moving at 10 in/s from update 0
+	tracker::tracker_s_t t;
+	for (int i = -50; i < 0; i++)
+		tracker::update(t, 0, dt, gains);
+
+	const double v = 10;
+	int reached = -1;     // first update within 10% of the new velocity
+	int settled = -1;     // last update with the acceleration above 10% of peak
+	double peak_v = 0;
+	double peak_a = 0;
+	double accel[400];
+	for (int i = 0; i < 400; i++) {
+		tracker::update(t, v * (i + 1) * dt, dt, gains);
+		if (reached < 0 && t.velocity >= .9 * v)
+			reached = i + 1;
+		peak_v = fmax(peak_v, t.velocity);
+		peak_a = fmax(peak_a, fabs(t.acceleration));
+		accel[i] = t.acceleration;
+	}
+	for (int i = 0; i < 400; i++)
+		if (fabs(accel[i]) > .1 * peak_a)
+			settled = i + 1;
+	double overshoot = peak_v / v - 1;
+	printf("velocity step: reached in %d updates, overshoot %.0f%%, "
+	       "acceleration settled in %d updates\n",
+	       reached, overshoot * 100, settled);
+	CHECK(reached > 0 && reached <= 6, "velocity took %d updates", reached);
+	CHECK(overshoot <= 1 / 3.0 + .01, "velocity overshot by %.2f", overshoot);
+	CHECK(settled > 0 && settled <= 20, "acceleration took %d updates",
+	      settled);
+	CHECK(fabs(t.velocity - v) < 1e-6 && fabs(t.acceleration) < 1e-6,
+	      "velocity step has a steady state error");
+
+	// constant acceleration is tracked without lag
+	tracker::tracker_s_t c;
+	const double a = 50;
+	for (int i = 0; i < 500; i++) {
+		double time = i * dt;
+		tracker::update(c, a * time * time / 2, dt, gains);
+	}
+	double time = 499 * dt;
+	printf("constant acceleration: velocity error %.2e, acceleration error "
+	       "%.2e\n",
+	       c.velocity - a * time, c.acceleration - a);
+	CHECK(fabs(c.velocity - a * time) < 1e-3 && fabs(c.acceleration - a) < 1e-3,
+	      "constant acceleration is tracked with lag");
+
+	// encoder quantization noise, one tick of a 360 tick per inch wheel
+	// rounding a steady 20.3 in/s
+	tracker::tracker_s_t q;
+	double sum = 0, sum_sq = 0;
+	int n = 0;
+	for (int i = 0; i < 2000; i++) {
+		double measured = round(20.3 * i * dt * 360) / 360;
+		tracker::update(q, measured, dt, gains);
+		if (i >= 1000) {
+			sum += q.velocity;
+			sum_sq += q.velocity * q.velocity;
+			n++;
+		}
+	}
+	double mean = sum / n;
+	double sd = sqrt(fmax(sum_sq / n - mean * mean, 0));
+	printf("quantized 20.3 in/s: mean %.3f in/s, noise %.3f in/s\n", mean, sd);
+	CHECK(fabs(mean - 20.3) < .05, "quantized velocity is biased");
+
+	return report("tracker_test");
+}
@@ -0,0 +1,70 @@
+#include "ARMS/voltage.h"
+#include "test.h"
+
+#include <cmath>
+
+// Simulate the same open loop drive on batteries at different charge, with
+// and without voltage compensation, and compare how far the robot travels.
+
+using namespace arms;
+
+const double dt = .01;          // control period (s)
+const double nominal = 11.5;    // NOMINAL_VOLTAGE (V)
+const double gain = .02;        // battery filter gain, as in the chassis
+const int motors = 6;
+const double motor_r = 4.8;     // winding resistance, 2.5 A stall at 12 V
+const double battery_r = .1;    // internal resistance of the battery (ohm)
+const double free_speed = 60;   // robot speed at 12 V (in/s)
+const double tau = .25;         // time constant of the drive (s)
+
+// drive at command percent for 1.5 s, returning the distance travelled
+double drive(double open_circuit, double command, bool compensated) {
+	double v = 0, x = 0, current = 0;
+	double filtered = 0;
+	for (double t = 0; t < 1.5; t += dt) {
+		// the battery sags under the current drawn in the last period
+		double battery = open_circuit - battery_r * current;
+		filtered = voltage::filter(filtered, battery, gain);
+
+		double percent = compensated
+		                     ? voltage::compensate(command, nominal, filtered)
+		                     : command;
+		double duty = fmin(fmax(percent, -100), 100) / 100;
+		double applied = duty * battery;
+
+		// first order drive, with back emf proportional to speed
+		double emf = v / free_speed * 12;
+		current = motors * fmax(applied - emf, 0) / motor_r;
+		v += (applied / 12 * free_speed - v) / tau * dt;
+		x += v * dt;
+	}
+	return x;
+}
+
+int main() {
+	CHECK(voltage::compensate(50, 0, 12) == 50,
+	      "compensation with no nominal voltage changes the command");
+	CHECK(voltage::filter(12, -1, gain) == 12, "an error reading was used");
+
+	const double charges[] = {11.8, 12.2, 12.6, 12.9};
+	double spread[2];
+	for (int c = 0; c < 2; c++) {
+		double lo = INFINITY, hi = -INFINITY;
+		printf("%s:", c ? "compensated" : "uncompensated");
+		for (double charge : charges) {
+			double d = drive(charge, 80, c);
+			printf(" %.1fV %.2f in", charge, d);
+			lo = fmin(lo, d);
+			hi = fmax(hi, d);
+		}
+		spread[c] = (hi - lo) / ((hi + lo) / 2);
+		printf(", spread %.2f%%\n", spread[c] * 100);
+	}
+
+	CHECK(spread[1] < .01, "compensated runs differ by %.2f%%",
+	      spread[1] * 100);
+	CHECK(spread[1] < spread[0] / 4,
+	      "compensation does not make runs more consistent");
+
+	return report("voltage_test");
+}